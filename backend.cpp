@@ -0,0 +1,235 @@
+#include "backend.h"
+#include "log.h"
+
+#include <algorithm>
+
+#include <X11/Xutil.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+static bool attachFailed;
+
+static int onAttachError(Display*, XErrorEvent*)
+{
+    attachFailed = true;
+    return 0;
+}
+
+// position of an 8 bit channel within a pixel
+static bool channelShift(unsigned long mask, int *shift)
+{
+    for (*shift = 0; *shift < 32 && !(mask & 1); (*shift)++) {
+        mask >>= 1;
+    }
+
+    return mask == 0xff;
+}
+
+static Bool isCompletion(Display*, XEvent *event, XPointer type)
+{
+    return event->type == *(int*)type;
+}
+
+void SdlBackend::present(const RenderContext &rc, const Options &options, FrameStore *frames)
+{
+    drawFrame(rc, options, frames);
+    SDL_RenderPresent(rc.sdlr);
+}
+
+void SdlBackend::presentFade(const RenderContext &rc, const Options &options, FrameStore *from, FrameStore *to,
+                             float amount)
+{
+    drawFrame(rc, options, from);
+    drawFrame(rc, options, to, std::max(0, std::min(255, (int)(amount * 255))));
+    SDL_RenderPresent(rc.sdlr);
+}
+
+ShmBackend *ShmBackend::create(Display *dpy, Window root, int width, int height)
+{
+    if (!XShmQueryExtension(dpy)) {
+        logWarning() << "X server does not support MIT-SHM\n";
+        return nullptr;
+    }
+
+    XWindowAttributes attributes;
+    XGetWindowAttributes(dpy, root, &attributes);
+    Visual *visual = attributes.visual;
+
+    ShmBackend *backend = new ShmBackend;
+    backend->dpy = dpy;
+    backend->root = root;
+    if (visual->c_class != TrueColor || !channelShift(visual->red_mask, &backend->redShift)
+        || !channelShift(visual->green_mask, &backend->greenShift) || !channelShift(visual->blue_mask, &backend->blueShift)) {
+        logWarning() << "root window has no 8 bit per channel TrueColor visual\n";
+        delete backend;
+        return nullptr;
+    }
+
+    // MIT-SHM only works locally, so the image has the byte order of this
+    // machine
+    XImage *image = XShmCreateImage(dpy, visual, attributes.depth, ZPixmap, NULL, &backend->segment, width, height);
+    backend->image = image;
+    if (!image || image->bits_per_pixel != 32) {
+        logWarning() << "failed to create a 32 bit shared memory image\n";
+        delete backend;
+        return nullptr;
+    }
+
+    backend->segment.shmid = shmget(IPC_PRIVATE, (size_t)image->bytes_per_line * image->height, IPC_CREAT | 0600);
+    if (backend->segment.shmid < 0) {
+        logWarning() << "failed to allocate shared memory\n";
+        delete backend;
+        return nullptr;
+    }
+    backend->segment.shmaddr = image->data = (char*)shmat(backend->segment.shmid, NULL, 0);
+    backend->segment.readOnly = False;
+
+    // a remote X server can not attach and only says so with an error
+    attachFailed = false;
+    XErrorHandler previous = XSetErrorHandler(onAttachError);
+    if (backend->segment.shmaddr != (char*)-1) {
+        backend->attached = XShmAttach(dpy, &backend->segment);
+        XSync(dpy, False);
+    }
+    XSetErrorHandler(previous);
+
+    // the segment goes away once both sides detached
+    shmctl(backend->segment.shmid, IPC_RMID, NULL);
+
+    if (!backend->attached || attachFailed) {
+        logWarning() << "failed to attach shared memory to the X server\n";
+        backend->attached = false;
+        delete backend;
+        return nullptr;
+    }
+
+    backend->gc = XCreateGC(dpy, root, 0, NULL);
+    backend->completionEvent = XShmGetEventBase(dpy) + ShmCompletion;
+    return backend;
+}
+
+ShmBackend::~ShmBackend()
+{
+    if (attached) {
+        waitForServer();
+        XShmDetach(dpy, &segment);
+        XSync(dpy, False);
+    }
+    if (image) {
+        // the pixels are shared memory, not allocated by Xlib
+        image->data = NULL;
+        XDestroyImage(image);
+    }
+    if (segment.shmaddr && segment.shmaddr != (char*)-1) {
+        shmdt(segment.shmaddr);
+    }
+    if (gc) {
+        XFreeGC(dpy, gc);
+    }
+}
+
+void ShmBackend::present(const RenderContext &rc, const Options &options, FrameStore *frames)
+{
+    int width, height, first, last;
+    const uint8_t *pixels = frames->pixels(&width, &height, &first, &last);
+    if (!pixels) {
+        return;
+    }
+
+    waitForServer();
+
+    // the image holds whatever the previous store showed
+    if (frames != lastStore) {
+        first = 0;
+        last = height - 1;
+        lastStore = frames;
+    }
+
+    switch (options.drawType) {
+        case DrawType::MONITOR:
+            blit(pixels, width, height, first, last, rc.monitors[options.monitorIndex]);
+            break;
+
+        case DrawType::AREA:
+            blit(pixels, width, height, first, last, options.targetArea);
+            break;
+
+        case DrawType::STRETCH:
+            blit(pixels, width, height, first, last, { 0, 0, rc.sdlwWidth, rc.sdlwHeight });
+            break;
+
+        case DrawType::EACH:
+            for (const SDL_Rect &rect : rc.monitors) {
+                blit(pixels, width, height, first, last, rect);
+            }
+    }
+
+    // the server reads the image while the next frame is prepared
+    XFlush(dpy);
+}
+
+void ShmBackend::reset()
+{
+    waitForServer();
+    memset(image->data, 0, (size_t)image->bytes_per_line * image->height);
+    put(0, 0, image->width, image->height);
+    XFlush(dpy);
+    lastStore = nullptr;
+}
+
+void ShmBackend::put(int x, int y, int width, int height)
+{
+    // the server sends a completion event once it read the image
+    pendingSerial = NextRequest(dpy);
+    XShmPutImage(dpy, root, gc, image, x, y, x, y, width, height, True);
+}
+
+void ShmBackend::waitForServer()
+{
+    // any event carries the serial of the last request the server finished,
+    // so whoever else reads events from the connection may have seen the
+    // completion already; only waiting for it avoids a round trip per frame
+    while (pendingSerial != 0 && LastKnownRequestProcessed(dpy) < pendingSerial) {
+        XEvent event;
+        XIfEvent(dpy, &event, isCompletion, (XPointer)&completionEvent);
+    }
+    pendingSerial = 0;
+}
+
+void ShmBackend::blit(const uint8_t *pixels, int width, int height, int first, int last, const SDL_Rect &area)
+{
+    int left = std::max(0, area.x), right = std::min(image->width, area.x + area.w);
+    int top = std::max(0, area.y), bottom = std::min(image->height, area.y + area.h);
+
+    // rows of the area showing a row of the frame which changed
+    bool scaled = width != area.w || height != area.h;
+    if (scaled) {
+        top = std::max(top, area.y + (int)(((int64_t)first * area.h + height - 1) / height));
+        bottom = std::min(bottom, area.y + (int)(((int64_t)(last + 1) * area.h + height - 1) / height));
+        columns.resize(area.w);
+        for (int x = 0; x < area.w; x++) {
+            columns[x] = (int64_t)x * width / area.w;
+        }
+    } else {
+        top = std::max(top, area.y + first);
+        bottom = std::min(bottom, area.y + last + 1);
+    }
+    if (left >= right || top >= bottom) {
+        return;
+    }
+
+    for (int y = top; y < bottom; y++) {
+        int sourceRow = scaled ? (int64_t)(y - area.y) * height / area.h : y - area.y;
+        const uint8_t *src = pixels + (size_t)sourceRow * width * 3;
+        uint32_t *dst = (uint32_t*)(image->data + (size_t)y * image->bytes_per_line);
+        for (int x = left; x < right; x++) {
+            const uint8_t *pixel = src + (scaled ? columns[x - area.x] : x - area.x) * 3;
+            dst[x] = (uint32_t)pixel[0] << redShift | (uint32_t)pixel[1] << greenShift | (uint32_t)pixel[2] << blueShift;
+        }
+    }
+
+    put(left, top, right - left, bottom - top);
+}
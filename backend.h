@@ -0,0 +1,76 @@
+#ifndef BACKEND_H_INCLUDED
+#define BACKEND_H_INCLUDED
+
+#include "video.h"
+
+#include <X11/extensions/XShm.h>
+
+// shows the current frame of a store on the root window
+class RenderBackend {
+public:
+    virtual ~RenderBackend() {}
+
+    // draws the current frame onto every area and shows it
+    virtual void present(const RenderContext&, const Options&, FrameStore*) = 0;
+    // like present, but with the frame of to blended over the frame of from
+    // by amount in [0, 1]; backends which can not blend show to only
+    virtual void presentFade(const RenderContext &rc, const Options &options, FrameStore *from, FrameStore *to,
+                             float amount) { present(rc, options, to); }
+    // whether presentFade blends at all
+    virtual bool fades() const { return false; }
+    // the areas frames are drawn on changed, so whatever is outside of the
+    // new ones has to be cleared
+    virtual void reset() {}
+    virtual const char *name() const = 0;
+};
+
+// copies textures with the SDL_Renderer wrapping the root window
+class SdlBackend : public RenderBackend {
+public:
+    void present(const RenderContext&, const Options&, FrameStore*) override;
+    void presentFade(const RenderContext&, const Options&, FrameStore *from, FrameStore *to, float amount) override;
+    bool fades() const override { return true; }
+    const char *name() const override { return "sdl"; }
+};
+
+// converts frames kept in RAM straight into a shared memory image and puts
+// the rows which changed onto the root window with MIT-SHM; without a GPU
+// this saves the copies and the scaling of SDL's software renderer
+class ShmBackend : public RenderBackend {
+public:
+    // returns nullptr if the X server has no MIT-SHM, shared memory can not
+    // be attached or the root window has no 32 bit TrueColor visual
+    static ShmBackend *create(Display *dpy, Window root, int width, int height);
+    ~ShmBackend();
+
+    void present(const RenderContext&, const Options&, FrameStore*) override;
+    void reset() override;
+    const char *name() const override { return "xshm"; }
+
+private:
+    ShmBackend() {}
+
+    // converts the frame into the given area of the image, scaling it if the
+    // sizes differ; only rows [first, last] of the frame changed
+    void blit(const uint8_t *pixels, int width, int height, int first, int last, const SDL_Rect &area);
+    // puts the given area of the image onto the same area of the root window
+    void put(int x, int y, int width, int height);
+    // blocks until the server finished reading the image, which has to be
+    // the case before anything is written into it again
+    void waitForServer();
+
+    Display *dpy;
+    Window root;
+    GC gc = nullptr;
+    XImage *image = nullptr;
+    XShmSegmentInfo segment = {};
+    bool attached = false;
+    int completionEvent;
+    unsigned long pendingSerial = 0; // of the last put the server may still be reading
+    std::vector<int> columns; // source column of every column of a scaled area
+    int redShift, greenShift, blueShift;
+
+    const FrameStore *lastStore = nullptr; // everything is drawn for a new store
+};
+
+#endif
@@ -0,0 +1,378 @@
+#include "xanim.h"
+#include "video.h"
+#include "convert.h"
+#include "stats.h"
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// benchmarks loading and playing synthetic videos without an X server or a
+// GPU; every run happens in a child process, so peak memory is measured per
+// run and OpenCV threads never cross a fork
+
+enum class Motion {
+    STATIC, // the same frame over and over
+    LOW, // a small square moving over a still background
+    HIGH // every pixel changes in every frame
+};
+
+struct BenchVideo {
+    int width, height, frames;
+    Motion motion;
+};
+
+// how the video is stored while playing
+struct BenchMode {
+    const char *name;
+    void (*apply)(Options*);
+};
+
+const double BENCH_FRAMERATE = 30.0;
+// conversions timed per pixel format
+const int CONVERT_ITERATIONS = 20;
+
+static const BenchMode MODES[] = {
+    { "preload", [](Options*) {} },
+    { "iyuv", [](Options *options) { options->pixelFormat = PixelFormat::IYUV; } },
+    { "delta", [](Options *options) { options->delta = true; } },
+    { "compress", [](Options *options) { options->compress = true; } },
+    { "stream", [](Options *options) { options->stream = true; } }
+};
+
+static const char *motionName(Motion motion)
+{
+    switch (motion) {
+        case Motion::STATIC: return "static";
+        case Motion::LOW: return "low";
+        case Motion::HIGH: return "high";
+    }
+
+    return "";
+}
+
+static std::string videoName(const BenchVideo &video)
+{
+    std::ostringstream name;
+    name << video.width << "x" << video.height << "-" << motionName(video.motion) << "-" << video.frames;
+    return name.str();
+}
+
+static double milliseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// runs work in a child process with stdout silenced and returns what it
+// produced; false if the child failed
+static bool inChild(const std::function<std::string()> &work, std::string *result)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+
+        std::string output = work();
+        size_t written = 0;
+        while (written < output.size()) {
+            ssize_t n = write(fds[1], output.data() + written, output.size() - written);
+            if (n <= 0) {
+                _exit(EXIT_FAILURE);
+            }
+            written += n;
+        }
+        _exit(output.empty() ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    close(fds[1]);
+    result->clear();
+    char buffer[4096];
+    for (ssize_t n; (n = read(fds[0], buffer, sizeof(buffer))) > 0;) {
+        result->append(buffer, n);
+    }
+    close(fds[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+static void drawSynthetic(cv::Mat &frame, Motion motion, int index)
+{
+    int width = frame.cols, height = frame.rows;
+    int shift = motion == Motion::HIGH ? index : 0;
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < width; x++) {
+            row[x * 3 + 0] = (x + shift * 8) * 255 / width;
+            row[x * 3 + 1] = (y + shift * 5) * 255 / height;
+            row[x * 3 + 2] = ((x ^ y) + shift * 3) & 0xff;
+        }
+    }
+
+    if (motion == Motion::LOW) {
+        int size = std::max(8, height / 8);
+        int x = (index * 4) % std::max(1, width - size);
+        cv::rectangle(frame, cv::Rect(x, (height - size) / 2, size, size), cv::Scalar(255, 255, 255), cv::FILLED);
+    }
+}
+
+static std::string writeVideo(const BenchVideo &video, const std::string &file)
+{
+    cv::VideoWriter writer(file, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), BENCH_FRAMERATE,
+                           cv::Size(video.width, video.height));
+    if (!writer.isOpened()) {
+        std::cerr << "failed to create " << file << "\n";
+        return "";
+    }
+
+    cv::Mat frame(video.height, video.width, CV_8UC3);
+    for (int index = 0; index < video.frames; index++) {
+        drawSynthetic(frame, video.motion, index);
+        writer << frame;
+    }
+
+    return "ok";
+}
+
+// average cost of converting a decoded frame into every pixel format
+static std::string measureConversion(const std::string &file)
+{
+    cv::VideoCapture vc;
+    cv::Mat frame;
+    if (!vc.open(file) || !vc.read(frame)) {
+        return "";
+    }
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(1) << "{";
+    const PixelFormat formats[] = { PixelFormat::RGB24, PixelFormat::IYUV, PixelFormat::NV12, PixelFormat::RGB565 };
+    for (PixelFormat format : formats) {
+        // planar formats only take even sizes
+        cv::Mat source = frame;
+        if (evenSize(format)) {
+            source = frame(cv::Rect(0, 0, frame.cols & ~1, frame.rows & ~1));
+        }
+        std::vector<uint8_t> pixels(frameBytes(format, source.cols, source.rows));
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < CONVERT_ITERATIONS; i++) {
+            convertFrame(source, format, pixels.data());
+        }
+        double us = milliseconds(std::chrono::steady_clock::now() - start) * 1000 / CONVERT_ITERATIONS;
+
+        json << (format == formats[0] ? "" : ", ") << "\"" << formatName(format) << "\": " << us;
+    }
+    json << "}";
+
+    return json.str();
+}
+
+static bool createRenderer(int width, int height, RenderContext *rc)
+{
+    // no display and no GPU; offscreen needs SDL 2.0.12, dummy is older
+    for (const char *driver : { "offscreen", "dummy" }) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, driver);
+        if (SDL_Init(SDL_INIT_VIDEO) == 0) {
+            break;
+        }
+    }
+    if (!SDL_WasInit(SDL_INIT_VIDEO)) {
+        std::cerr << "failed to initialize SDL without a display: " << SDL_GetError() << "\n";
+        return false;
+    }
+
+    rc->dpy = nullptr;
+    rc->rootw = 0;
+    rc->sdlw = SDL_CreateWindow("xanim-bench", 0, 0, width, height, SDL_WINDOW_HIDDEN);
+    rc->sdlr = rc->sdlw ? SDL_CreateRenderer(rc->sdlw, -1, SDL_RENDERER_SOFTWARE) : nullptr;
+    if (!rc->sdlr) {
+        std::cerr << "failed to create software renderer: " << SDL_GetError() << "\n";
+        return false;
+    }
+    rc->sdlwWidth = width;
+    rc->sdlwHeight = height;
+    rc->refreshRate = 0;
+    rc->monitors = { { 0, 0, width, height } };
+
+    return true;
+}
+
+// loads the video like xanim does and plays it as fast as the software
+// renderer allows
+static std::string measurePlayback(const BenchVideo &benchVideo, const std::string &file, const BenchMode &mode)
+{
+    RenderContext rc;
+    if (!createRenderer(benchVideo.width, benchVideo.height, &rc)) {
+        return "";
+    }
+
+    Options options;
+    options.videoFile = file;
+    mode.apply(&options);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Video video = loadVideo(rc, options);
+    double firstFrame = milliseconds(std::chrono::steady_clock::now() - start);
+
+    // frames are measured once everything is loaded
+    while (video.frames->load(std::chrono::steady_clock::now() + std::chrono::seconds(1))) {
+    }
+    double startup = milliseconds(std::chrono::steady_clock::now() - start);
+
+    // the loop wraps around at least once
+    int frames = std::max(240, benchVideo.frames * 2);
+    int presented = 0, held = 0;
+    Histogram frameTimes;
+    start = std::chrono::steady_clock::now();
+    while (presented < frames) {
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        if (!video.frames->next()) {
+            // a background thread fell behind
+            held++;
+            SDL_Delay(1);
+            continue;
+        }
+        drawFrame(rc, options, video.frames);
+        SDL_RenderPresent(rc.sdlr);
+        frameTimes.add(std::chrono::steady_clock::now() - frameStart);
+        presented++;
+    }
+    double seconds = milliseconds(std::chrono::steady_clock::now() - start) / 1000;
+    size_t resident = video.frames->residentBytes();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3)
+        << "{ \"mode\": \"" << mode.name << "\", \"first_frame_ms\": " << firstFrame << ", \"startup_ms\": " << startup
+        << ", \"fps\": " << (seconds > 0 ? presented / seconds : 0)
+        << ", \"held\": " << held
+        << ", \"frame_ms\": { \"p50\": " << frameTimes.percentile(50) << ", \"p99\": " << frameTimes.percentile(99)
+        << ", \"max\": " << frameTimes.max() << " }"
+        << ", \"peak_rss_bytes\": " << (size_t)usage.ru_maxrss * 1024
+        << ", \"resident_bytes\": " << resident << " }";
+
+    // the process ends right away, nothing needs to be freed
+    return json.str();
+}
+
+static void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [--quick] [--out FILE] [--dir DIR]\n"
+        << "        --quick     only the small videos\n"
+        << "        --out FILE  write the JSON results to FILE instead of stdout\n"
+        << "        --dir DIR   where the synthetic videos are created (default /tmp)\n";
+}
+
+int main(int argc, char **argv)
+{
+    bool quick = false;
+    std::string out, dir = "/tmp";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out = argv[++i];
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<BenchVideo> videos;
+    const cv::Size sizes[] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+    for (const cv::Size &size : sizes) {
+        if (quick && size.width > 640) {
+            continue;
+        }
+        for (Motion motion : { Motion::STATIC, Motion::LOW, Motion::HIGH }) {
+            videos.push_back({ size.width, size.height, 120, motion });
+        }
+    }
+    if (!quick) {
+        videos.push_back({ 1280, 720, 30, Motion::LOW });
+        videos.push_back({ 1280, 720, 600, Motion::LOW });
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"videos\": [";
+    bool failed = false;
+    for (size_t v = 0; v < videos.size(); v++) {
+        const BenchVideo &video = videos[v];
+        std::string name = videoName(video);
+        std::string file = dir + "/xanim-bench-" + std::to_string(getpid()) + "-" + name + ".avi";
+        std::cerr << "[" << v + 1 << "/" << videos.size() << "] " << name << "\n";
+
+        std::string result;
+        if (!inChild([&] { return writeVideo(video, file); }, &result)) {
+            std::cerr << "failed to create synthetic video " << file << "\n";
+            return EXIT_FAILURE;
+        }
+
+        std::string conversion;
+        if (!inChild([&] { return measureConversion(file); }, &conversion)) {
+            std::cerr << "  conversion failed\n";
+            conversion = "null";
+            failed = true;
+        }
+
+        json << (v > 0 ? "," : "") << "\n    {\n"
+            << "      \"name\": \"" << name << "\", \"width\": " << video.width << ", \"height\": " << video.height
+            << ", \"frames\": " << video.frames << ", \"motion\": \"" << motionName(video.motion) << "\",\n"
+            << "      \"convert_us\": " << conversion << ",\n"
+            << "      \"runs\": [";
+        for (size_t m = 0; m < sizeof(MODES) / sizeof(MODES[0]); m++) {
+            std::cerr << "  " << MODES[m].name << "\n";
+            if (!inChild([&] { return measurePlayback(video, file, MODES[m]); }, &result)) {
+                std::cerr << "  " << MODES[m].name << " failed\n";
+                result = std::string("{ \"mode\": \"") + MODES[m].name + "\", \"failed\": true }";
+                failed = true;
+            }
+            json << (m > 0 ? "," : "") << "\n        " << result;
+        }
+        json << "\n      ]\n    }";
+
+        unlink(file.c_str());
+    }
+    json << "\n  ]\n}\n";
+
+    if (out.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream(out) << json.str();
+        std::cerr << "results written to " << out << "\n";
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,225 @@
+#include "budget.h"
+#include "video.h"
+#include "stream.h"
+#include "compress.h"
+#include "convert.h"
+#include "log.h"
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <algorithm>
+
+#include <math.h>
+#include <stdlib.h>
+
+static size_t mib(size_t bytes)
+{
+    return bytes / (1024 * 1024);
+}
+
+size_t textureBytes(PixelFormat format, int width, int height)
+{
+    if (format == PixelFormat::RGB24) {
+        return (size_t)width * height * TEXTURE_PIXEL_BYTES;
+    }
+
+    return frameBytes(format, width, height);
+}
+
+bool probeVideo(const std::string &file, VideoProbe *probe)
+{
+    cv::VideoCapture vc;
+    if (!vc.open(file)) {
+        return false;
+    }
+
+    probe->width = vc.get(cv::CAP_PROP_FRAME_WIDTH);
+    probe->height = vc.get(cv::CAP_PROP_FRAME_HEIGHT);
+    probe->frameCount = vc.get(cv::CAP_PROP_FRAME_COUNT);
+    probe->framerate = vc.get(cv::CAP_PROP_FPS);
+    return probe->width > 0 && probe->height > 0;
+}
+
+size_t probeCompressed(const std::string &file, int width, int height, double step)
+{
+    cv::VideoCapture vc;
+    if (!vc.open(file)) {
+        return 0;
+    }
+
+    // consecutive frames of the output rate, as the compressor gets them
+    FrameCompressor compressor(frameBytes(PixelFormat::RGB24, width, height));
+    std::vector<uint8_t> pixels(frameBytes(PixelFormat::RGB24, width, height));
+    cv::Mat frame, scaled;
+    size_t bytes = 0, frames = 0;
+    for (double source = 0; frames < COMPRESS_PROBE_FRAMES; source += step) {
+        bool read = true;
+        for (size_t pos = vc.get(cv::CAP_PROP_POS_FRAMES); read && pos < (size_t)source; pos++) {
+            read = vc.grab();
+        }
+        if (!read || !vc.read(frame) || frame.empty()) {
+            break;
+        }
+
+        const cv::Mat *input = &frame;
+        if (frame.cols != width || frame.rows != height) {
+            cv::resize(frame, scaled, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+            input = &scaled;
+        }
+        convertFrame(*input, pixels.data());
+        bytes += compressor.compress(pixels.data()).data.size();
+        frames++;
+    }
+
+    return frames > 0 ? bytes / frames : 0;
+}
+
+Options planStorage(const RenderContext &rc, const Options &requested)
+{
+    Options options = requested;
+
+    // loadVideo complains about videos which can not be opened
+    VideoProbe probe;
+    if (options.maxMemory == 0 || !probeVideo(options.videoFile, &probe)) {
+        return options;
+    }
+
+    // only the frames of the output rate are stored
+    if (options.fps > 0 && options.fps < probe.framerate) {
+        probe.frameCount = ceil(probe.frameCount * options.fps / probe.framerate);
+    }
+
+    // frames are never scaled up
+    PixelFormat format = options.pixelFormat;
+    size_t sourceTexture = textureBytes(format, probe.width, probe.height);
+    size_t scaledTextures = 0, largestTexture = 0, largestFrame = 0;
+    for (const SDL_Point &size : targetSizes(rc, options)) {
+        int width = std::min(size.x, probe.width), height = std::min(size.y, probe.height);
+        scaledTextures += textureBytes(format, width, height);
+        largestTexture = std::max(largestTexture, textureBytes(format, width, height));
+        largestFrame = std::max(largestFrame, frameBytes(format, width, height));
+    }
+
+    size_t preload = probe.frameCount * sourceTexture;
+    size_t prescaled = probe.frameCount * scaledTextures;
+    // resident head and upload textures plus the decoded window; 24 bit RGB
+    // is widened to 32 bits when it is decoded straight into textures
+    size_t streamFixed = (STREAM_HEAD_FRAMES + STREAM_SHOWN_FRAMES) * largestTexture;
+    size_t streamFrame = format == PixelFormat::RGB24 ? largestTexture : largestFrame;
+
+    logInfo() << "predicted memory use: " << mib(preload) << " MiB preloaded, " << mib(prescaled)
+        << " MiB prescaled, " << mib(streamFixed + options.streamFrames * streamFrame)
+        << " MiB streamed; budget is " << mib(options.maxMemory) << " MiB\n";
+
+    if (options.delta) {
+        logInfo() << "the size of delta frames depends on the video, keeping --delta\n";
+        return options;
+    }
+    if (options.compress && !options.stream) {
+        logInfo() << "the size of compressed frames depends on the video, keeping --compress\n";
+        return options;
+    }
+
+    // cache files already hold frames at their destination size
+    if (options.cache) {
+        if (!options.stream && probe.frameCount * largestTexture > options.maxMemory) {
+            logInfo() << "streaming from the cache to stay within the memory budget\n";
+            options.stream = true;
+        }
+        return options;
+    }
+
+    if (!options.stream) {
+        if (!options.prescale && preload <= options.maxMemory) {
+            return options;
+        }
+        if (prescaled <= options.maxMemory) {
+            if (!options.prescale) {
+                logInfo() << "prescaling frames to stay within the memory budget\n";
+            }
+            options.prescale = true;
+            return options;
+        }
+
+        // 12 bit frames if the renderer takes them as they are
+        if (format == PixelFormat::RGB24 && nativeFormat(rc, PixelFormat::IYUV)) {
+            size_t compact = 0;
+            for (const SDL_Point &size : targetSizes(rc, options)) {
+                compact += textureBytes(PixelFormat::IYUV, std::min(size.x, probe.width), std::min(size.y, probe.height));
+            }
+            if (probe.frameCount * compact <= options.maxMemory) {
+                logInfo() << "prescaling frames and storing them as iyuv to stay within the memory budget\n";
+                options.prescale = true;
+                options.pixelFormat = PixelFormat::IYUV;
+                return options;
+            }
+        }
+
+        // compressed frames at the destination size, if the first frames of
+        // the video compress well enough
+        if (format == PixelFormat::RGB24) {
+            int width, height;
+            targetSize(rc, options, &width, &height);
+            width = std::min(width, probe.width);
+            height = std::min(height, probe.height);
+            double step = options.fps > 0 && options.fps < probe.framerate ? probe.framerate / options.fps : 1;
+            size_t perFrame = probeCompressed(options.videoFile, width, height, step) * COMPRESS_MARGIN;
+            size_t compressed = COMPRESSED_UPLOADS * textureBytes(format, width, height)
+                + COMPRESSED_WINDOW * frameBytes(format, width, height) + probe.frameCount * perFrame;
+            if (perFrame > 0) {
+                logInfo() << "predicted memory use: " << mib(compressed) << " MiB compressed\n";
+            }
+            if (perFrame > 0 && compressed <= options.maxMemory) {
+                logInfo() << "compressing frames to stay within the memory budget\n";
+                options.prescale = true;
+                options.compress = true;
+                return options;
+            }
+        }
+
+        logInfo() << "streaming to stay within the memory budget\n";
+        options.stream = true;
+    }
+
+    // streams always come at the destination size, and the window shrinks
+    // until it fits
+    options.prescale = true;
+    while (options.streamFrames > 2 && streamFixed + options.streamFrames * streamFrame > options.maxMemory) {
+        options.streamFrames--;
+    }
+    if (streamFixed + options.streamFrames * streamFrame > options.maxMemory) {
+        logWarning() << "even streaming needs more than the memory budget of " << mib(options.maxMemory) << " MiB\n";
+    } else if (options.streamFrames != requested.streamFrames) {
+        logInfo() << "stream window reduced to " << options.streamFrames << " frames\n";
+    }
+
+    return options;
+}
+
+bool parseSize(const char *text, size_t *bytes)
+{
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text) {
+        return false;
+    }
+
+    switch (*end) {
+        case 'G': case 'g':
+            value *= 1024;
+            // fall through
+        case 'M': case 'm':
+            value *= 1024;
+            // fall through
+        case 'K': case 'k':
+            value *= 1024;
+            end++;
+            break;
+        default:
+            break;
+    }
+
+    *bytes = value;
+    return *end == '\0';
+}
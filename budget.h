@@ -0,0 +1,42 @@
+#ifndef BUDGET_H_INCLUDED
+#define BUDGET_H_INCLUDED
+
+#include "xanim.h"
+
+#include <string>
+
+// renderers store 24 bit frames with a fourth byte per pixel
+const size_t TEXTURE_PIXEL_BYTES = 4;
+// frames compressed to predict the size of a compressed video
+const size_t COMPRESS_PROBE_FRAMES = 8;
+// the start of a video often moves less than the rest, so the prediction
+// is taken this many times
+const double COMPRESS_MARGIN = 1.5;
+
+// memory a texture holding a frame of the given format takes
+size_t textureBytes(PixelFormat, int width, int height);
+
+// what is known about a video before decoding it
+struct VideoProbe {
+    int width, height;
+    size_t frameCount; // as reported by the container
+    double framerate;
+};
+
+// returns false if the video can not be opened
+bool probeVideo(const std::string &file, VideoProbe*);
+// average compressed size of the first COMPRESS_PROBE_FRAMES frames of
+// the video at the given size and every step-th source frame; 0 if it can
+// not be read
+size_t probeCompressed(const std::string &file, int width, int height, double step);
+
+// picks the first storage strategy whose predicted footprint fits into
+// options.maxMemory: full preload, prescaled preload, prescaled preload of
+// 12 bit frames, compressed frames or streaming; a strategy chosen on the
+// command line is kept
+Options planStorage(const RenderContext&, const Options&);
+
+// parses a size like 512M or 2G; returns false if it is malformed
+bool parseSize(const char *text, size_t *bytes);
+
+#endif
@@ -0,0 +1,316 @@
+#include "cache.h"
+#include "decoder.h"
+#include "log.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char CACHE_MAGIC[8] = { 'x', 'a', 'n', 'i', 'm', 'c', 'a', 'c' };
+const uint32_t CACHE_VERSION = 4;
+
+// start of every cache file, followed by the frames at dataOffset
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t width, height, pitch;
+    uint32_t format; // PixelFormat of the frames
+    uint64_t sourceHash;
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    uint32_t targetWidth, targetHeight;
+    uint64_t frameCount;
+    uint64_t dataOffset, frameStride;
+    double framerate;
+    double rate; // see CacheKey
+};
+
+static size_t pageAlign(size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+static std::string cachePath(const std::string &dir, const CacheKey &key)
+{
+    char name[80], rate[24] = "";
+    if (key.rate > 0) {
+        snprintf(rate, sizeof(rate), "-%gfps", key.rate);
+    }
+    snprintf(name, sizeof(name), "/%016llx-%ix%i-%s%s.cache", (unsigned long long)key.sourceHash,
+             key.targetWidth, key.targetHeight, formatName(key.format), rate);
+    return dir + name;
+}
+
+// mkdir -p
+static bool makeDirs(const std::string &dir)
+{
+    size_t pos = 0;
+    do {
+        pos = dir.find('/', pos + 1);
+        std::string part = dir.substr(0, pos);
+        if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+    } while (pos != std::string::npos);
+
+    return true;
+}
+
+FrameCache::~FrameCache()
+{
+    munmap(map, mapSize);
+}
+
+FrameCache *FrameCache::open(const std::string &dir, const CacheKey &key)
+{
+    std::string path = cachePath(dir, key);
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return nullptr;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return nullptr;
+    }
+
+    const CacheHeader *header = (const CacheHeader*)map;
+    bool valid = memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+        && header->version == CACHE_VERSION
+        && header->sourceHash == key.sourceHash
+        && header->sourceMtime == key.sourceMtime
+        && header->sourceSize == key.sourceSize
+        && header->targetWidth == (uint32_t)key.targetWidth
+        && header->targetHeight == (uint32_t)key.targetHeight
+        && header->format == (uint32_t)key.format
+        && header->rate == key.rate
+        && header->frameCount > 0
+        && header->dataOffset + header->frameCount * header->frameStride <= (uint64_t)st.st_size;
+    if (!valid) {
+        logInfo() << "cache file " << path << " is outdated\n";
+        munmap(map, st.st_size);
+        return nullptr;
+    }
+
+    FrameCache *cache = new FrameCache;
+    cache->map = (uint8_t*)map;
+    cache->mapSize = st.st_size;
+    cache->dataOffset = header->dataOffset;
+    cache->frameStride = header->frameStride;
+    cache->frameCount = header->frameCount;
+    cache->width = header->width;
+    cache->height = header->height;
+    cache->pitch = header->pitch;
+    cache->format = key.format;
+    cache->framerate = header->framerate;
+
+    logInfo() << "using cache file " << path << "\n";
+    return cache;
+}
+
+bool FrameCache::build(const std::string &dir, const std::string &file, const CacheKey &key, int jobs)
+{
+    if (!makeDirs(dir)) {
+        logError() << "failed to create cache directory " << dir << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    // written under a temporary name so an interrupted build is never used
+    std::string path = cachePath(dir, key);
+    std::string tmpPath = path + ".tmp";
+    FILE *f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        logError() << "failed to create cache file " << tmpPath << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    ParallelDecoder decoder(file, jobs, { cv::Size(key.targetWidth, key.targetHeight) }, key.format, key.rate);
+    if (!decoder.opened()) {
+        fclose(f);
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.width = decoder.width;
+    header.height = decoder.height;
+    header.pitch = framePitch(key.format, decoder.width);
+    header.format = (uint32_t)key.format;
+    header.sourceHash = key.sourceHash;
+    header.sourceMtime = key.sourceMtime;
+    header.sourceSize = key.sourceSize;
+    header.targetWidth = key.targetWidth;
+    header.targetHeight = key.targetHeight;
+    header.frameCount = 0;
+    header.dataOffset = pageAlign(sizeof(CacheHeader));
+    size_t bytes = frameBytes(key.format, decoder.width, decoder.height);
+    header.frameStride = pageAlign(bytes);
+    header.framerate = decoder.framerate;
+    header.rate = key.rate;
+
+    logInfo() << "writing cache file " << path << " with frames of " << header.width << "x" << header.height << "\n";
+
+    bool ok = true;
+    size_t cached = 0;
+    std::vector<bool> written; // frames arrive out of order from the segments
+    Progress progress("caching frames", decoder.frameCount);
+    while (PixelBuffer *buffer = decoder.wait()) {
+        logDebug() << "caching frame " << buffer->frame << "\n";
+        progress.update(++cached);
+
+        // the gap up to the next page boundary stays a hole in the file
+        ok = ok && fseek(f, header.dataOffset + buffer->frame * header.frameStride, SEEK_SET) == 0
+            && fwrite(buffer->pixels[0], bytes, 1, f) == 1;
+        header.frameCount = std::max<uint64_t>(header.frameCount, buffer->frame + 1);
+        if (written.size() < header.frameCount) {
+            written.resize(header.frameCount, false);
+        }
+        written[buffer->frame] = true;
+        decoder.release(buffer);
+    }
+
+    // a frame which failed to decode would be played back as a zero-filled
+    // hole, so such a cache is never committed
+    auto missing = std::find(written.begin(), written.end(), false);
+    if (missing != written.end()) {
+        logWarning() << "frame " << missing - written.begin() << " could not be decoded, not writing cache file "
+                     << path << "\n";
+        fclose(f);
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    ok = ok && header.frameCount > 0
+        && fseek(f, 0, SEEK_SET) == 0
+        && fwrite(&header, sizeof(header), 1, f) == 1
+        && fflush(f) == 0
+        && ftruncate(fileno(f), header.dataOffset + header.frameCount * header.frameStride) == 0;
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        logError() << "failed to write cache file " << path << ": " << strerror(errno) << "\n";
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    logInfo() << header.frameCount << " frames were cached\n";
+    return true;
+}
+
+void FrameCache::prefetch(size_t index) const
+{
+    madvise((void*)frame(index), frameStride, MADV_WILLNEED);
+}
+
+CacheStore::CacheStore(const RenderContext &rc, FrameCache *cache)
+    : cache(cache)
+{
+    for (SDL_Texture *&texture : uploads) {
+        texture = SDL_CreateTexture(rc.sdlr, sdlFormat(cache->format), SDL_TEXTUREACCESS_STREAMING,
+                                    cache->width, cache->height);
+        if (!texture) {
+            logError() << "failed to create streaming texture: " << SDL_GetError() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    cache->prefetch(0);
+}
+
+CacheStore::~CacheStore()
+{
+    for (SDL_Texture *texture : uploads) {
+        SDL_DestroyTexture(texture);
+    }
+
+    delete cache;
+}
+
+bool CacheStore::next()
+{
+    uploadIndex ^= 1;
+    SDL_UpdateTexture(uploads[uploadIndex], NULL, cache->frame(cursor), cache->pitch);
+
+    // let the kernel read ahead while this frame is shown
+    cursor = (cursor + 1) % cache->frameCount;
+    cache->prefetch(cursor);
+
+    return true;
+}
+
+SDL_Texture *CacheStore::texture(int width, int height)
+{
+    return uploads[uploadIndex];
+}
+
+size_t CacheStore::residentBytes() const
+{
+    return textureMemory(uploads[0]) + textureMemory(uploads[1]);
+}
+
+bool cacheKey(const std::string &file, int targetWidth, int targetHeight, PixelFormat format, double rate,
+              CacheKey *key)
+{
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    // a 64 bit hash is plenty to tell videos apart
+    key->sourceHash = hashBytes((const uint8_t*)map, st.st_size);
+    munmap(map, st.st_size);
+    key->sourceMtime = st.st_mtime;
+    key->sourceSize = st.st_size;
+    key->targetWidth = targetWidth;
+    key->targetHeight = targetHeight;
+    key->format = format;
+    key->rate = rate;
+    return true;
+}
+
+std::string defaultCacheDir()
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) {
+        return std::string(xdg) + "/xanim";
+    }
+
+    const char *home = getenv("HOME");
+    if (home && *home) {
+        return std::string(home) + "/.cache/xanim";
+    }
+
+    return "/tmp/xanim";
+}
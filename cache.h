@@ -0,0 +1,76 @@
+#ifndef CACHE_H_INCLUDED
+#define CACHE_H_INCLUDED
+
+#include "video.h"
+
+#include <string>
+
+#include <stdint.h>
+
+// identifies the cache file of a video shown at a given size
+struct CacheKey {
+    uint64_t sourceHash; // hash of the video file contents
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    int targetWidth, targetHeight; // size of the area the video is shown on
+    PixelFormat format; // of the stored frames
+    double rate; // the frames were resampled to, 0 for the source rate
+};
+
+// frames of a video which were converted and scaled ahead of time; every
+// frame starts on a page boundary, so it can be uploaded straight from the
+// mapping without ever touching the decoder
+class FrameCache {
+public:
+    ~FrameCache();
+
+    // maps the cache file matching key; returns nullptr if there is none or
+    // it was written for a different version of the video
+    static FrameCache *open(const std::string &dir, const CacheKey&);
+    // decodes the video with the given number of decoder threads and writes
+    // its cache file; nothing is written if any frame fails to decode
+    static bool build(const std::string &dir, const std::string &file, const CacheKey&, int jobs);
+
+    const uint8_t *frame(size_t index) const { return map + dataOffset + index * frameStride; }
+    // hint that the given frame will be read soon
+    void prefetch(size_t index) const;
+
+    size_t frameCount;
+    int width, height, pitch; // dimensions of the stored frames, pitch of their first plane
+    PixelFormat format;
+    double framerate;
+
+private:
+    FrameCache() {}
+
+    uint8_t *map;
+    size_t mapSize;
+    size_t dataOffset, frameStride;
+};
+
+// plays frames directly from the mapping; the frames live in the page
+// cache instead of the process, so memory stays flat for any video length
+class CacheStore : public FrameStore {
+public:
+    // takes ownership of the cache
+    CacheStore(const RenderContext&, FrameCache *cache);
+    ~CacheStore();
+
+    bool next() override;
+    SDL_Texture *texture(int width, int height) override;
+    // the mapping is only counted by the kernel
+    size_t residentBytes() const override;
+
+private:
+    FrameCache *cache;
+    SDL_Texture *uploads[2];
+    int uploadIndex = 0;
+    size_t cursor = 0;
+};
+
+// computes the key of a video; returns false if the file can not be read
+bool cacheKey(const std::string &file, int targetWidth, int targetHeight, PixelFormat, double rate, CacheKey*);
+// $XDG_CACHE_HOME/xanim or ~/.cache/xanim
+std::string defaultCacheDir();
+
+#endif
@@ -0,0 +1,128 @@
+#include "compress.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void fail(const std::string &what, const std::string &input)
+{
+    printf("FAIL %s: %s\n", what.c_str(), input.c_str());
+    failures++;
+}
+
+// compresses input, checks the bound and that it decompresses to exactly the
+// same bytes, and that a wrong size or a cut block is refused
+static void roundTrip(const std::string &name, const std::vector<uint8_t> &input)
+{
+    std::vector<uint8_t> packed(compressBound(input.size()) + 16, 0xa5);
+    size_t packedSize = compressBlock(input.data(), input.size(), packed.data());
+    if (packedSize > compressBound(input.size())) {
+        fail("compressed size " + std::to_string(packedSize) + " exceeds the bound", name);
+        return;
+    }
+    if (packed[compressBound(input.size())] != 0xa5) {
+        fail("wrote past the bound", name);
+    }
+
+    std::vector<uint8_t> output(input.size() + 1, 0);
+    if (!decompressBlock(packed.data(), packedSize, output.data(), input.size())) {
+        fail("block does not decompress", name);
+        return;
+    }
+    if (!std::equal(input.begin(), input.end(), output.begin())) {
+        fail("decompressed bytes differ", name);
+    }
+
+    if (decompressBlock(packed.data(), packedSize, output.data(), input.size() + 1)) {
+        fail("decompressed into a larger buffer", name);
+    }
+    if (!input.empty() && decompressBlock(packed.data(), packedSize, output.data(), input.size() - 1)) {
+        fail("decompressed into a smaller buffer", name);
+    }
+    for (size_t cut = 1; cut < packedSize && cut <= 64; cut++) {
+        if (decompressBlock(packed.data(), packedSize - cut, output.data(), input.size())) {
+            fail("decompressed a block cut short by " + std::to_string(cut) + " bytes", name);
+            break;
+        }
+    }
+}
+
+static std::vector<uint8_t> randomBytes(size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t &byte : bytes) {
+        byte = rand() & 0xff;
+    }
+
+    return bytes;
+}
+
+static std::vector<uint8_t> repeated(const std::string &pattern, size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++) {
+        bytes[i] = pattern[i % pattern.size()];
+    }
+
+    return bytes;
+}
+
+int main()
+{
+    srand(1);
+
+    roundTrip("empty", {});
+
+    // below, at and above the shortest block a match is searched in
+    for (size_t size = 1; size <= 40; size++) {
+        roundTrip("zeros of " + std::to_string(size), std::vector<uint8_t>(size, 0));
+        roundTrip("random bytes of " + std::to_string(size), randomBytes(size));
+    }
+
+    // literal runs around the lengths which need extra length bytes
+    for (size_t size : { 14, 15, 16, 269, 270, 271, 524, 525, 526, 65536, 1 << 20 }) {
+        roundTrip("incompressible " + std::to_string(size), randomBytes(size));
+    }
+
+    // long runs, which are matches overlapping themselves at offset 1
+    for (size_t size : { 19, 20, 274, 275, 1000, 65540, 8 << 20 }) {
+        roundTrip("run of " + std::to_string(size), std::vector<uint8_t>(size, 7));
+    }
+
+    // offsets shorter than the match, and shorter than a word
+    for (const char *pattern : { "ab", "abc", "abcde", "abcdefg", "0123456789abcdef!" }) {
+        roundTrip(std::string("pattern ") + pattern, repeated(pattern, 5000));
+    }
+
+    // matches at the largest offset and just beyond it
+    for (size_t distance : { 65530, 65535, 65536, 70000 }) {
+        std::vector<uint8_t> bytes = randomBytes(distance + 4096);
+        std::copy(bytes.begin(), bytes.begin() + 4096, bytes.begin() + distance);
+        roundTrip("match at distance " + std::to_string(distance), bytes);
+    }
+
+    // frame-like input: mostly unchanged with a few noisy tiles
+    std::vector<uint8_t> frame(1920 * 1080 * 3, 0);
+    for (int tile = 0; tile < 50; tile++) {
+        size_t at = (size_t)rand() % (frame.size() - 4096);
+        std::vector<uint8_t> noise = randomBytes(1 + rand() % 4096);
+        std::copy(noise.begin(), noise.end(), frame.begin() + at);
+    }
+    roundTrip("sparse frame difference", frame);
+
+    // garbage must be refused without reading or writing out of bounds
+    std::vector<uint8_t> output(4096);
+    for (int attempt = 0; attempt < 10000; attempt++) {
+        std::vector<uint8_t> garbage = randomBytes(1 + rand() % 64);
+        decompressBlock(garbage.data(), garbage.size(), output.data(), output.size());
+    }
+
+    printf("%s: %d failures\n", failures ? "FAIL" : "OK", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
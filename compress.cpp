@@ -0,0 +1,398 @@
+#include "compress.h"
+#include "log.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+// positions of earlier 4 byte sequences are remembered in a table of
+// 2^HASH_BITS entries
+const int HASH_BITS = 14;
+const size_t MIN_MATCH = 4;
+// the end of a block is always stored as literals
+const size_t LAST_LITERALS = 5;
+const size_t MATCH_SEARCH_END = 12;
+const size_t MAX_OFFSET = 65535;
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t read64(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// lengths of 15 and more continue in the following bytes
+static uint8_t *writeLength(uint8_t *out, size_t length)
+{
+    for (length -= 15; length >= 255; length -= 255) {
+        *out++ = 255;
+    }
+    *out++ = length;
+    return out;
+}
+
+static bool readLength(const uint8_t **in, const uint8_t *end, size_t *length)
+{
+    uint8_t byte;
+    do {
+        if (*in == end) {
+            return false;
+        }
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+static uint8_t *writeSequence(uint8_t *out, const uint8_t *literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+    uint8_t *token = out++;
+    *token = std::min<size_t>(literalCount, 15) << 4;
+    if (literalCount >= 15) {
+        out = writeLength(out, literalCount);
+    }
+    if (literalCount > 0) {
+        memcpy(out, literals, literalCount);
+        out += literalCount;
+    }
+
+    // the last sequence has no match
+    if (offset == 0) {
+        return out;
+    }
+
+    size_t length = matchLength - MIN_MATCH;
+    *token |= std::min<size_t>(length, 15);
+    *out++ = offset;
+    *out++ = offset >> 8;
+    if (length >= 15) {
+        out = writeLength(out, length);
+    }
+    return out;
+}
+
+size_t compressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t compressBlock(const uint8_t *src, size_t size, uint8_t *dst)
+{
+    std::vector<uint32_t> table(1 << HASH_BITS, 0);
+    uint8_t *out = dst;
+    size_t anchor = 0, pos = 0;
+
+    if (size > MATCH_SEARCH_END) {
+        size_t limit = size - MATCH_SEARCH_END, matchLimit = size - LAST_LITERALS;
+        while (pos < limit) {
+            uint32_t sequence = read32(src + pos);
+            uint32_t hash = sequence * 2654435761u >> (32 - HASH_BITS);
+            size_t candidate = table[hash];
+            table[hash] = pos;
+
+            if (candidate >= pos || pos - candidate > MAX_OFFSET || read32(src + candidate) != sequence) {
+                // skip ahead faster the longer nothing matched
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            size_t length = MIN_MATCH;
+            while (pos + length + 8 <= matchLimit && read64(src + candidate + length) == read64(src + pos + length)) {
+                length += 8;
+            }
+            while (pos + length < matchLimit && src[candidate + length] == src[pos + length]) {
+                length++;
+            }
+
+            out = writeSequence(out, src + anchor, pos - anchor, pos - candidate, length);
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    out = writeSequence(out, src + anchor, size - anchor, 0, 0);
+    return out - dst;
+}
+
+bool decompressBlock(const uint8_t *src, size_t size, uint8_t *dst, size_t dstSize)
+{
+    const uint8_t *in = src, *end = src + size;
+    uint8_t *out = dst, *outEnd = dst + dstSize;
+
+    while (in < end) {
+        uint8_t token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(&in, end, &literals)) {
+            return false;
+        }
+        if (literals > (size_t)(end - in) || literals > (size_t)(outEnd - out)) {
+            return false;
+        }
+        memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+
+        if (in == end) {
+            break;
+        }
+
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = in[0] | in[1] << 8;
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(&in, end, &length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(out - dst) || length > (size_t)(outEnd - out)) {
+            return false;
+        }
+
+        // overlapping matches repeat the last offset bytes; every copy
+        // doubles the part which can be copied at once
+        const uint8_t *match = out - offset;
+        while (length > 0) {
+            size_t chunk = std::min(length, (size_t)(out - match));
+            memcpy(out, match, chunk);
+            out += chunk;
+            length -= chunk;
+        }
+    }
+
+    return out == outEnd;
+}
+
+FrameCompressor::FrameCompressor(size_t frameBytes)
+    : previous(frameBytes), difference(frameBytes), packed(compressBound(frameBytes))
+{
+}
+
+CompressedFrame FrameCompressor::compress(const uint8_t *pixels)
+{
+    CompressedFrame frame;
+    size_t size = previous.size();
+    const uint8_t *input = pixels;
+
+    if (first) {
+        frame.keyframe = true;
+        first = false;
+    } else {
+        if (memcmp(pixels, previous.data(), size) == 0) {
+            return frame;
+        }
+        for (size_t i = 0; i < size; i++) {
+            difference[i] = pixels[i] ^ previous[i];
+        }
+        input = difference.data();
+    }
+    memcpy(previous.data(), pixels, size);
+
+    size_t packedSize = compressBlock(input, size, packed.data());
+    frame.data.assign(packed.begin(), packed.begin() + packedSize);
+    return frame;
+}
+
+CompressedStore::CompressedStore(const RenderContext &rc, PixelFormat format, int width, int height,
+                                 std::vector<CompressedFrame> &&compressed)
+    : sdlr(rc.sdlr), format(format), width(width), height(height),
+      readyBuffers(COMPRESSED_WINDOW), freeBuffers(COMPRESSED_WINDOW)
+{
+    for (CompressedFrame &frame : compressed) {
+        if (frame.data.empty() && !frames.empty()) {
+            frames.back().duration += frame.duration;
+        } else {
+            frames.push_back(std::move(frame));
+        }
+    }
+
+    damageFirst = 0;
+    damageLast = height - 1;
+
+    for (Buffer &buffer : buffers) {
+        buffer.pixels.resize(frameBytes(format, width, height));
+        freeBuffers.push(&buffer);
+    }
+
+    thread = std::thread(&CompressedStore::run, this);
+}
+
+CompressedStore::~CompressedStore()
+{
+    stopping = true;
+    producer.notify();
+    thread.join();
+
+    for (SDL_Texture *texture : uploads) {
+        if (texture) {
+            SDL_DestroyTexture(texture);
+        }
+    }
+}
+
+bool CompressedStore::load(std::chrono::steady_clock::time_point until)
+{
+    // a handful of textures, so they are all created at once
+    for (SDL_Texture *&texture : uploads) {
+        if (!sdlr || texture) {
+            continue;
+        }
+        texture = SDL_CreateTexture(sdlr, sdlFormat(format), SDL_TEXTUREACCESS_STREAMING, width, height);
+        if (!texture) {
+            logWarning() << "failed to create streaming texture: " << SDL_GetError() << "\n";
+            return false;
+        }
+    }
+
+    return false;
+}
+
+bool CompressedStore::next()
+{
+    // nothing has been shown yet, so there is no frame to hold
+    if (!started) {
+        consumer.wait([this] { return !readyBuffers.empty(); });
+        started = true;
+    }
+
+    Buffer *buffer;
+    if (!readyBuffers.pop(buffer)) {
+        // the worker fell behind, so hold the current frame
+        return false;
+    }
+    cursor = buffer->frame;
+
+    // without a renderer the buffer stays until the next frame replaces it
+    if (!sdlr) {
+        if (shown) {
+            freeBuffers.push(shown);
+            producer.notify();
+        }
+        shown = buffer;
+        damageFirst = std::min(damageFirst, buffer->first);
+        damageLast = std::max(damageLast, buffer->last);
+        return true;
+    }
+
+    uploadIndex = (uploadIndex + 1) % COMPRESSED_UPLOADS;
+    SDL_UpdateTexture(uploads[uploadIndex], NULL, buffer->pixels.data(), framePitch(format, width));
+    current = uploads[uploadIndex];
+
+    freeBuffers.push(buffer);
+    producer.notify();
+    return true;
+}
+
+SDL_Texture *CompressedStore::texture(int width, int height)
+{
+    return current;
+}
+
+int CompressedStore::duration()
+{
+    return frames[cursor].duration;
+}
+
+size_t CompressedStore::residentBytes() const
+{
+    size_t bytes = this->bytes();
+    for (const Buffer &buffer : buffers) {
+        bytes += buffer.pixels.size();
+    }
+    for (SDL_Texture *texture : uploads) {
+        bytes += textureMemory(texture);
+    }
+
+    return bytes;
+}
+
+const uint8_t *CompressedStore::pixels(int *width, int *height, int *first, int *last)
+{
+    if (!shown || format != PixelFormat::RGB24) {
+        return nullptr;
+    }
+
+    *width = this->width;
+    *height = this->height;
+    *first = damageFirst;
+    *last = damageLast;
+    damageFirst = this->height;
+    damageLast = -1;
+    return shown->pixels.data();
+}
+
+size_t CompressedStore::bytes() const
+{
+    size_t bytes = 0;
+    for (const CompressedFrame &frame : frames) {
+        bytes += frame.data.size();
+    }
+
+    return bytes;
+}
+
+void CompressedStore::run()
+{
+    // the frame before the one being decompressed
+    std::vector<uint8_t> previous(frameBytes(format, width, height));
+    size_t frameIndex = 0;
+
+    while (!stopping) {
+        Buffer *buffer;
+        if (!freeBuffers.pop(buffer)) {
+            // every buffer is queued or being uploaded
+            producer.wait([this] { return stopping || !freeBuffers.empty(); });
+            continue;
+        }
+
+        const CompressedFrame &frame = frames[frameIndex];
+        std::vector<uint8_t> &pixels = buffer->pixels;
+        if (!decompressBlock(frame.data.data(), frame.data.size(), pixels.data(), pixels.size())) {
+            logError() << "compressed frame " << frameIndex << " is corrupt\n";
+            std::exit(EXIT_FAILURE);
+        }
+        buffer->first = 0;
+        buffer->last = height - 1;
+        if (!frame.keyframe && format == PixelFormat::RGB24) {
+            // rows of the difference which are not all zero changed
+            size_t pitch = framePitch(format, width);
+            buffer->first = height;
+            buffer->last = -1;
+            for (int y = 0; y < height; y++) {
+                uint8_t *row = &pixels[y * pitch];
+                const uint8_t *previousRow = &previous[y * pitch];
+                uint8_t changed = 0;
+                for (size_t x = 0; x < pitch; x++) {
+                    changed |= row[x];
+                    row[x] ^= previousRow[x];
+                }
+                if (changed) {
+                    buffer->first = std::min(buffer->first, y);
+                    buffer->last = y;
+                }
+            }
+        } else if (!frame.keyframe) {
+            for (size_t i = 0; i < pixels.size(); i++) {
+                pixels[i] ^= previous[i];
+            }
+        }
+        memcpy(previous.data(), pixels.data(), pixels.size());
+
+        buffer->frame = frameIndex;
+        readyBuffers.push(buffer);
+        consumer.notify();
+
+        // the first frame is a keyframe, so the loop wraps around without
+        // anything to undo
+        frameIndex = frameIndex + 1 < frames.size() ? frameIndex + 1 : 0;
+    }
+}
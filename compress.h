@@ -0,0 +1,97 @@
+#ifndef COMPRESS_H_INCLUDED
+#define COMPRESS_H_INCLUDED
+
+#include "video.h"
+#include "spscqueue.h"
+
+#include <atomic>
+#include <thread>
+
+#include <stdint.h>
+
+// frames decompressed ahead of the one shown
+const size_t COMPRESSED_WINDOW = 4;
+// streaming textures frames are uploaded into in turn
+const size_t COMPRESSED_UPLOADS = 2;
+
+// LZ77 blocks in the style of LZ4: runs of literals followed by a copy from
+// earlier output, which decompress at close to memory speed
+size_t compressBound(size_t size);
+// dst needs room for compressBound(size) bytes; returns the compressed size
+size_t compressBlock(const uint8_t *src, size_t size, uint8_t *dst);
+// returns false unless the block decompresses to exactly dstSize bytes
+bool decompressBlock(const uint8_t *src, size_t size, uint8_t *dst, size_t dstSize);
+
+struct CompressedFrame {
+    std::vector<uint8_t> data; // empty if the frame repeats the previous one
+    bool keyframe = false; // compressed on its own instead of as a difference
+    int duration = 1; // in frame periods
+};
+
+// compresses consecutive frames of one sequence; the first one is stored on
+// its own, the others as their XOR with the previous frame, which leaves
+// runs of zeros wherever nothing moved
+class FrameCompressor {
+public:
+    explicit FrameCompressor(size_t frameBytes);
+
+    CompressedFrame compress(const uint8_t *pixels);
+
+private:
+    std::vector<uint8_t> previous, difference, packed;
+    bool first = true;
+};
+
+// keeps every frame compressed in RAM; a worker thread decompresses the
+// frames ahead of the play cursor, which are uploaded into a few streaming
+// textures, so the loop wraps around without seeking in the video; without
+// a renderer, frames are handed out as pixels instead
+class CompressedStore : public FrameStore {
+public:
+    // frames[0] has to be a keyframe; with a renderer, the textures are
+    // created by the first call to load(), so the store can be filled on
+    // another thread
+    CompressedStore(const RenderContext&, PixelFormat, int width, int height, std::vector<CompressedFrame> &&frames);
+    ~CompressedStore();
+
+    bool next() override;
+    SDL_Texture *texture(int width, int height) override;
+    int duration() override;
+    size_t residentBytes() const override;
+    bool load(std::chrono::steady_clock::time_point until) override;
+    bool ready() const override { return !sdlr || uploads[COMPRESSED_UPLOADS - 1]; }
+    const uint8_t *pixels(int *width, int *height, int *first, int *last) override;
+
+    // memory used by the compressed frames
+    size_t bytes() const;
+
+private:
+    struct Buffer {
+        std::vector<uint8_t> pixels;
+        size_t frame;
+        int first, last; // rows which differ from the previous frame
+    };
+
+    void run();
+
+    std::vector<CompressedFrame> frames;
+    SDL_Renderer *sdlr;
+    PixelFormat format;
+    int width, height;
+
+    std::thread thread;
+    std::atomic<bool> stopping { false };
+    Buffer buffers[COMPRESSED_WINDOW];
+    SpscQueue<Buffer*> readyBuffers, freeBuffers;
+    Parking producer, consumer;
+
+    SDL_Texture *uploads[COMPRESSED_UPLOADS] = {};
+    size_t uploadIndex = 0;
+    SDL_Texture *current = nullptr;
+    Buffer *shown = nullptr; // without a renderer, the buffer of the current frame
+    int damageFirst, damageLast; // rows changed since pixels() was called
+    bool started = false;
+    size_t cursor = 0;
+};
+
+#endif
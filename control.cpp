@@ -0,0 +1,292 @@
+#include "control.h"
+#include "backend.h"
+#include "filetype.h"
+#include "gif.h"
+#include "log.h"
+
+#include <sstream>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// longest line a client may send
+const size_t MAX_COMMAND = 4096;
+
+std::string defaultControlPath()
+{
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && *runtime) {
+        return std::string(runtime) + "/xanim.sock";
+    }
+
+    return "/tmp/xanim-" + std::to_string(getuid()) + ".sock";
+}
+
+Controller::Controller(const RenderContext &rc, Options *options, Playlist *playlist, FrameScheduler *scheduler,
+                       PlaybackStats *stats)
+    : rc(rc), options(options), playlist(playlist), scheduler(scheduler), stats(stats)
+{
+}
+
+Controller::~Controller()
+{
+    for (const std::pair<const int, std::string> &client : clients) {
+        close(client.first);
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(path.c_str());
+    }
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+}
+
+bool Controller::listen(const std::string &path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        logWarning() << "control socket path " << path << " is too long\n";
+        return false;
+    }
+    strcpy(address.sun_path, path.c_str());
+
+    // a socket nobody accepts on is left over from a previous run
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0 && connect(probe, (sockaddr*)&address, sizeof(address)) == 0) {
+        close(probe);
+        logWarning() << "another xanim already listens on " << path << "\n";
+        return false;
+    }
+    if (probe >= 0) {
+        close(probe);
+    }
+    unlink(path.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (listenFd < 0 || epollFd < 0 || bind(listenFd, (sockaddr*)&address, sizeof(address)) != 0) {
+        logWarning() << "failed to create control socket " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    this->path = path;
+
+    // only the user running xanim may control it
+    chmod(path.c_str(), 0600);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    if (::listen(listenFd, 4) != 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) != 0) {
+        logWarning() << "failed to listen on control socket " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    logInfo() << "listening for commands on " << path << "\n";
+    return true;
+}
+
+bool Controller::update()
+{
+    if (epollFd < 0) {
+        return true;
+    }
+
+    epoll_event events[8];
+    int count;
+    while ((count = epoll_wait(epollFd, events, 8, 0)) > 0) {
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                accept();
+            } else if (!receive(fd)) {
+                disconnect(fd);
+            }
+        }
+    }
+
+    return !quitting;
+}
+
+void Controller::wait(int timeout)
+{
+    if (epollFd < 0) {
+        SDL_Delay(timeout);
+        return;
+    }
+
+    struct pollfd fds[1] = { { epollFd, POLLIN, 0 } };
+    poll(fds, 1, timeout);
+}
+
+void Controller::accept()
+{
+    int client;
+    while ((client = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = client;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, client, &event) != 0) {
+            close(client);
+            continue;
+        }
+        clients[client];
+    }
+}
+
+bool Controller::receive(int client)
+{
+    std::string &pending = clients[client];
+    char buffer[512];
+    ssize_t size;
+    while ((size = recv(client, buffer, sizeof(buffer), 0)) > 0) {
+        pending.append(buffer, size);
+    }
+    bool open = size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+
+    size_t end;
+    while ((end = pending.find('\n')) != std::string::npos) {
+        std::string line = pending.substr(0, end);
+        pending.erase(0, end + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+
+        size_t space = line.find(' ');
+        std::string command = line.substr(0, space);
+        std::string argument = space == std::string::npos ? "" : line.substr(space + 1);
+
+        bool ok = true;
+        std::string reply = run(command, argument, &ok);
+        reply = ok ? reply + "ok\n" : "error " + reply + "\n";
+        send(client, reply.data(), reply.size(), MSG_NOSIGNAL);
+    }
+
+    if (pending.size() > MAX_COMMAND) {
+        static const char tooLong[] = "error command too long\n";
+        send(client, tooLong, sizeof(tooLong) - 1, MSG_NOSIGNAL);
+        return false;
+    }
+
+    return open;
+}
+
+std::string Controller::run(const std::string &command, const std::string &argument, bool *ok)
+{
+    logInfo() << "control command: " << command << (argument.empty() ? "" : " ") << argument << "\n";
+
+    if (command == "load") {
+        if (access(argument.c_str(), R_OK) != 0) {
+            *ok = false;
+            return "cannot read " + argument;
+        }
+        // opening and decoding the file would hold the current video, so
+        // only its signature is checked here; a broken video is skipped
+        // with a warning once the prepare thread fails to open it
+        if (!isGif(argument) && !hasVideoSignature(argument)) {
+            *ok = false;
+            return "not a video: " + argument;
+        }
+        playlist->play(argument);
+        return "";
+    }
+
+    if (command == "next") {
+        playlist->skip();
+        return "";
+    }
+
+    if (command == "monitor") {
+        int index = atoi(argument.c_str());
+        if (argument.empty() || index < 0 || index >= (int)rc.monitors.size()) {
+            *ok = false;
+            return "monitor index out of range";
+        }
+        options->drawType = DrawType::MONITOR;
+        options->monitorIndex = index;
+        redraw();
+        return "";
+    }
+
+    if (command == "area") {
+        SDL_Rect area;
+        if (sscanf(argument.c_str(), "%ix%i+%i+%i", &area.w, &area.h, &area.x, &area.y) != 4
+            || area.w <= 0 || area.h <= 0) {
+            *ok = false;
+            return "area has to be WxH+X+Y";
+        }
+        options->drawType = DrawType::AREA;
+        options->targetArea = area;
+        redraw();
+        return "";
+    }
+
+    if (command == "stretch" || command == "each") {
+        options->drawType = command == "stretch" ? DrawType::STRETCH : DrawType::EACH;
+        redraw();
+        return "";
+    }
+
+    if (command == "pause") {
+        pausing = true;
+        return "";
+    }
+
+    if (command == "resume") {
+        // the frames due while paused are not caught up on
+        if (pausing) {
+            scheduler->restart();
+        }
+        pausing = false;
+        return "";
+    }
+
+    if (command == "fps") {
+        char *end;
+        double rate = strtod(argument.c_str(), &end);
+        if (argument.empty() || *end || rate < 0) {
+            *ok = false;
+            return "fps has to be a number, 0 for no limit";
+        }
+        scheduler->setMaxRate(rate);
+        return "";
+    }
+
+    if (command == "stats") {
+        std::ostringstream out;
+        stats->print(out);
+        return out.str();
+    }
+
+    if (command == "quit") {
+        quitting = true;
+        return "";
+    }
+
+    *ok = false;
+    return "unknown command " + command;
+}
+
+void Controller::redraw()
+{
+    rc.backend->reset();
+    playlist->redraw();
+}
+
+void Controller::disconnect(int client)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, client, NULL);
+    close(client);
+    clients.erase(client);
+}
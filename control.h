@@ -0,0 +1,68 @@
+#ifndef CONTROL_H_INCLUDED
+#define CONTROL_H_INCLUDED
+
+#include "video.h"
+#include "playlist.h"
+#include "scheduler.h"
+#include "stats.h"
+
+#include <map>
+#include <string>
+
+// $XDG_RUNTIME_DIR/xanim.sock, or a per-user file in /tmp without it
+std::string defaultControlPath();
+
+// carries out the commands of a local control socket on the running player;
+// every line a client sends is a command and its argument, every reply ends
+// with a line "ok" or "error MESSAGE":
+//   load FILE        switch to FILE as soon as its first frame is loaded
+//   next             switch to the next video of the playlist
+//   monitor N, area WxH+X+Y, stretch, each
+//                    draw somewhere else, keeping the loaded frames
+//   pause, resume
+//   fps N            present at most N frames per second, 0 for no limit
+//   stats            playback statistics
+//   quit
+class Controller {
+public:
+    Controller(const RenderContext&, Options*, Playlist*, FrameScheduler*, PlaybackStats*);
+    ~Controller();
+
+    // creates the socket, replacing a stale one; returns false if that fails
+    bool listen(const std::string &path);
+    // runs the commands clients sent without blocking; returns false once
+    // one of them asked to quit
+    bool update();
+    // sleeps until a client connects or sends something, or timeout ms
+    // passed
+    void wait(int timeout);
+
+    // readable once a client connects or sends something, -1 without a
+    // socket
+    int fd() const { return epollFd; }
+    bool paused() const { return pausing; }
+
+private:
+    void accept();
+    // reads what a client sent; returns false once it hung up
+    bool receive(int client);
+    // returns the lines of the reply before the final "ok", or the message
+    // of the error
+    std::string run(const std::string &command, const std::string &argument, bool *ok);
+    // draws the current frame at once after the areas changed
+    void redraw();
+    void disconnect(int client);
+
+    const RenderContext &rc;
+    Options *options;
+    Playlist *playlist;
+    FrameScheduler *scheduler;
+    PlaybackStats *stats;
+
+    std::string path;
+    int listenFd = -1, epollFd = -1;
+    std::map<int, std::string> clients; // unfinished line of every client
+    bool pausing = false, quitting = false;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "convert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+// bytes after every row which must never be written
+const size_t GUARD_BYTES = 37;
+const uint8_t GUARD = 0xa5;
+
+static int failures = 0;
+
+static void fail(const char *what, const char *kernel, int channels, int width)
+{
+    printf("FAIL %s: %s, %d channels, width %d\n", what, kernel, channels, width);
+    failures++;
+}
+
+static std::vector<uint8_t> randomBytes(size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t &byte : bytes) {
+        byte = rand() & 0xff;
+    }
+
+    return bytes;
+}
+
+static void testKernel(const char *name, ConvertRowsFunc convert, int channels, int width)
+{
+    const int height = 3;
+    // odd pitches keep the rows unaligned
+    size_t srcPitch = width * channels + 13;
+    size_t dstPitch = width * 3 + GUARD_BYTES;
+    std::vector<uint8_t> src = randomBytes(srcPitch * height);
+    std::vector<uint8_t> expected(dstPitch * height, GUARD), actual(dstPitch * height, GUARD);
+
+    convertRowsScalar(src.data(), srcPitch, channels, expected.data(), dstPitch, width, height);
+    convert(src.data(), srcPitch, channels, actual.data(), dstPitch, width, height);
+
+    if (actual != expected) {
+        fail("rows differ from the scalar version", name, channels, width);
+    }
+
+    // the scalar version itself against the definition
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const uint8_t *in = &src[y * srcPitch + x * channels];
+            const uint8_t *out = &expected[y * dstPitch + x * 3];
+            if (out[0] != in[2] || out[1] != in[1] || out[2] != in[0]) {
+                fail("pixel is not swapped from BGR to RGB", "scalar", channels, width);
+                return;
+            }
+        }
+        for (size_t x = width * 3; x < dstPitch; x++) {
+            if (expected[y * dstPitch + x] != GUARD) {
+                fail("wrote past the end of the row", "scalar", channels, width);
+                return;
+            }
+        }
+    }
+}
+
+// a region of a larger frame has rows which are not next to each other
+static void testRegion(int channels)
+{
+    cv::Mat frame(24, 57, CV_8UC(channels));
+    std::vector<uint8_t> bytes = randomBytes(frame.total() * frame.elemSize());
+    memcpy(frame.data, bytes.data(), bytes.size());
+    cv::Mat region = frame(cv::Rect(5, 3, 33, 17));
+    if (region.isContinuous()) {
+        fail("region is contiguous", "convertFrame", channels, region.cols);
+    }
+
+    int pitch = region.cols * 3 + GUARD_BYTES;
+    std::vector<uint8_t> tight(region.cols * region.rows * 3), padded(pitch * region.rows, GUARD);
+    convertFrame(region, tight.data());
+    convertFrame(region, padded.data(), pitch);
+
+    for (int y = 0; y < region.rows; y++) {
+        const uint8_t *in = region.ptr(y);
+        for (int x = 0; x < region.cols; x++) {
+            const uint8_t *bgr = in + x * channels;
+            const uint8_t *a = &tight[(y * region.cols + x) * 3];
+            const uint8_t *b = &padded[y * pitch + x * 3];
+            if (a[0] != bgr[2] || a[1] != bgr[1] || a[2] != bgr[0] || memcmp(a, b, 3) != 0) {
+                fail("region converted wrongly", "convertFrame", channels, region.cols);
+                return;
+            }
+        }
+        if (padded[y * pitch + region.cols * 3] != GUARD) {
+            fail("wrote past the end of the row", "convertFrame", channels, region.cols);
+            return;
+        }
+    }
+}
+
+int main()
+{
+    srand(1);
+
+    struct Kernel {
+        const char *name;
+        ConvertRowsFunc convert;
+        bool supported;
+    };
+    std::vector<Kernel> kernels = { { "picked", convertRows, true } };
+#ifdef CONVERT_X86
+    __builtin_cpu_init();
+    kernels.push_back({ "ssse3", convertRowsSSSE3, (bool)__builtin_cpu_supports("ssse3") });
+    kernels.push_back({ "avx2", convertRowsAVX2, (bool)__builtin_cpu_supports("avx2") });
+#endif
+
+    // around the steps of 4, 5, 8 and 10 pixels and the scalar tail
+    const int widths[] = { 1, 2, 3, 5, 6, 7, 10, 11, 12, 15, 16, 17, 21, 31, 32, 33, 63, 64, 65, 1920 };
+    for (const Kernel &kernel : kernels) {
+        if (!kernel.supported) {
+            printf("skipping %s, which the cpu does not support\n", kernel.name);
+            continue;
+        }
+        for (int channels : { 3, 4 }) {
+            for (int width : widths) {
+                testKernel(kernel.name, kernel.convert, channels, width);
+            }
+        }
+    }
+
+    testRegion(3);
+    testRegion(4);
+
+    printf("%s: %d failures\n", failures ? "FAIL" : "OK", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
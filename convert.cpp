@@ -0,0 +1,287 @@
+#include "convert.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+
+#include <string.h>
+
+#ifdef CONVERT_X86
+#include <immintrin.h>
+#endif
+
+void convertRowsScalar(const uint8_t *src, size_t srcPitch, int channels,
+                       uint8_t *dst, size_t dstPitch, int width, int height)
+{
+    for (int y = 0; y < height; y++) {
+        const uint8_t *in = src + y * srcPitch;
+        uint8_t *out = dst + y * dstPitch;
+        for (int x = 0; x < width; x++) {
+            // opencv uses BGR, but we want RGB
+            out[0] = in[2];
+            out[1] = in[1];
+            out[2] = in[0];
+            in += channels;
+            out += 3;
+        }
+    }
+}
+
+#ifdef CONVERT_X86
+
+// The SIMD versions below read and write a few bytes past the pixels they
+// convert in each step; those bytes are rewritten by the following step, so
+// every row stops early enough to stay inside the row and hands the last
+// pixels to the scalar version.
+
+__attribute__((target("ssse3")))
+void convertRowsSSSE3(const uint8_t *src, size_t srcPitch, int channels,
+                      uint8_t *dst, size_t dstPitch, int width, int height)
+{
+    // 5 BGR pixels of a 16 byte load, or 4 BGRA pixels packed into 12 bytes
+    const __m128i shuffle3 = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    const __m128i shuffle4 = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *in = src + y * srcPitch;
+        uint8_t *out = dst + y * dstPitch;
+        int x = 0;
+
+        if (channels == 3) {
+            for (; x + 6 <= width; x += 5) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(in + 3 * x));
+                _mm_storeu_si128((__m128i*)(out + 3 * x), _mm_shuffle_epi8(v, shuffle3));
+            }
+        } else {
+            for (; x + 6 <= width; x += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(in + 4 * x));
+                _mm_storeu_si128((__m128i*)(out + 3 * x), _mm_shuffle_epi8(v, shuffle4));
+            }
+        }
+
+        convertRowsScalar(in + channels * x, srcPitch, channels, out + 3 * x, dstPitch, width - x, 1);
+    }
+}
+
+__attribute__((target("avx2")))
+void convertRowsAVX2(const uint8_t *src, size_t srcPitch, int channels,
+                     uint8_t *dst, size_t dstPitch, int width, int height)
+{
+    // shuffles work per 128 bit lane, so each lane gets the same pattern
+    const __m256i shuffle3 = _mm256_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15,
+                                              2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    const __m256i shuffle4 = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                              2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    // moves the 12 valid bytes of both lanes next to each other
+    const __m256i pack4 = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *in = src + y * srcPitch;
+        uint8_t *out = dst + y * dstPitch;
+        int x = 0;
+
+        if (channels == 3) {
+            // two runs of 5 pixels, one per lane; the upper store overwrites
+            // the spare byte of the lower one
+            for (; x + 11 <= width; x += 10) {
+                const uint8_t *i = in + 3 * x;
+                uint8_t *o = out + 3 * x;
+                __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)i)),
+                                                    _mm_loadu_si128((const __m128i*)(i + 15)), 1);
+                v = _mm256_shuffle_epi8(v, shuffle3);
+                _mm_storeu_si128((__m128i*)o, _mm256_castsi256_si128(v));
+                _mm_storeu_si128((__m128i*)(o + 15), _mm256_extracti128_si256(v, 1));
+            }
+        } else {
+            for (; x + 11 <= width; x += 8) {
+                __m256i v = _mm256_loadu_si256((const __m256i*)(in + 4 * x));
+                v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuffle4), pack4);
+                _mm256_storeu_si256((__m256i*)(out + 3 * x), v);
+            }
+        }
+
+        convertRowsScalar(in + channels * x, srcPitch, channels, out + 3 * x, dstPitch, width - x, 1);
+    }
+}
+
+#endif
+
+static ConvertRowsFunc pickConvertRows()
+{
+#ifdef CONVERT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return convertRowsAVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return convertRowsSSSE3;
+    }
+#endif
+    return convertRowsScalar;
+}
+
+ConvertRowsFunc convertRows = pickConvertRows();
+
+void convertFrame(const cv::Mat &frame, uint8_t *pixelData, int pitch)
+{
+    // opencv mat format may differ, but we need a common pixel format to shove into
+    // SDL (we will use 8 bits per channel with 3 channels)
+    cv::Mat converted;
+    const cv::Mat *frame8 = &frame;
+    if (frame.depth() != CV_8U) {
+        frame.convertTo(converted, CV_8U);
+        frame8 = &converted;
+    }
+
+    convertRows(frame8->ptr(), frame8->step, frame8->channels(),
+                pixelData, pitch ? pitch : frame8->cols * 3, frame8->cols, frame8->rows);
+}
+
+// 8 bit BGR without an alpha channel, which the color conversions expect
+static const cv::Mat &frameBGR(const cv::Mat &frame, cv::Mat &converted)
+{
+    const cv::Mat *source = &frame;
+    if (frame.depth() != CV_8U) {
+        frame.convertTo(converted, CV_8U);
+        source = &converted;
+    }
+    if (source->channels() == 4) {
+        cv::cvtColor(*source, converted, cv::COLOR_BGRA2BGR);
+        source = &converted;
+    }
+
+    return *source;
+}
+
+// 4x4 bayer matrix, spreading the rounding error of RGB565 over neighbours
+static const uint8_t BAYER[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+static void convertRGB565(const cv::Mat &bgr, uint8_t *pixelData, int pitch)
+{
+    for (int y = 0; y < bgr.rows; y++) {
+        const uint8_t *row = bgr.ptr(y);
+        uint16_t *out = (uint16_t*)(pixelData + (size_t)y * pitch);
+        const uint8_t *bayer = BAYER[y & 3];
+        for (int x = 0; x < bgr.cols; x++) {
+            // the threshold adds up to one step of the target precision
+            int t = bayer[x & 3];
+            int r = std::min(31, (row[x * 3 + 2] + t / 2) >> 3);
+            int g = std::min(63, (row[x * 3 + 1] + t / 4) >> 2);
+            int b = std::min(31, (row[x * 3 + 0] + t / 2) >> 3);
+            *out++ = (uint16_t)(r << 11 | g << 5 | b);
+        }
+    }
+}
+
+void convertFrame(const cv::Mat &frame, PixelFormat format, uint8_t *pixelData, int pitch)
+{
+    if (format == PixelFormat::RGB24) {
+        convertFrame(frame, pixelData, pitch);
+        return;
+    }
+
+    cv::Mat converted;
+    const cv::Mat &bgr = frameBGR(frame, converted);
+    int width = bgr.cols, height = bgr.rows;
+
+    switch (format) {
+        case PixelFormat::IYUV: {
+            // writes straight into the buffer as the header matches
+            cv::Mat yuv(height * 3 / 2, width, CV_8UC1, pixelData);
+            cv::cvtColor(bgr, yuv, cv::COLOR_BGR2YUV_I420);
+            break;
+        }
+
+        case PixelFormat::NV12: {
+            // opencv has no NV12 target, so the chroma planes of I420 are
+            // interleaved afterwards
+            thread_local cv::Mat yuv;
+            cv::cvtColor(bgr, yuv, cv::COLOR_BGR2YUV_I420);
+            size_t lumaBytes = (size_t)width * height, chromaBytes = lumaBytes / 4;
+            memcpy(pixelData, yuv.ptr(), lumaBytes);
+
+            const uint8_t *u = yuv.ptr() + lumaBytes;
+            const uint8_t *v = u + chromaBytes;
+            uint8_t *uv = pixelData + lumaBytes;
+            for (size_t i = 0; i < chromaBytes; i++) {
+                uv[i * 2] = u[i];
+                uv[i * 2 + 1] = v[i];
+            }
+            break;
+        }
+
+        case PixelFormat::RGB565:
+            convertRGB565(bgr, pixelData, pitch ? pitch : width * 2);
+            break;
+
+        case PixelFormat::XRGB32: {
+            // the unused byte is set like an opaque alpha channel
+            cv::Mat xrgb(height, width, CV_8UC4, pixelData, pitch ? pitch : width * 4);
+            cv::cvtColor(bgr, xrgb, cv::COLOR_BGR2BGRA);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+size_t frameBytes(PixelFormat format, int width, int height)
+{
+    size_t pixels = (size_t)width * height;
+    switch (format) {
+        case PixelFormat::IYUV:
+        case PixelFormat::NV12:
+            return pixels * 3 / 2;
+        case PixelFormat::RGB565:
+            return pixels * 2;
+        case PixelFormat::XRGB32:
+            return pixels * 4;
+        default:
+            return pixels * 3;
+    }
+}
+
+int framePitch(PixelFormat format, int width)
+{
+    switch (format) {
+        case PixelFormat::IYUV:
+        case PixelFormat::NV12:
+            return width;
+        case PixelFormat::RGB565:
+            return width * 2;
+        case PixelFormat::XRGB32:
+            return width * 4;
+        default:
+            return width * 3;
+    }
+}
+
+bool evenSize(PixelFormat format)
+{
+    return format == PixelFormat::IYUV || format == PixelFormat::NV12;
+}
+
+static const char *FORMAT_NAMES[] = { "rgb24", "iyuv", "nv12", "rgb565", "xrgb32" };
+
+const char *formatName(PixelFormat format)
+{
+    return FORMAT_NAMES[(int)format];
+}
+
+bool parseFormat(const char *name, PixelFormat *format)
+{
+    for (int i = 0; i < (int)PixelFormat::XRGB32; i++) {
+        if (strcmp(name, FORMAT_NAMES[i]) == 0) {
+            *format = (PixelFormat)i;
+            return true;
+        }
+    }
+
+    return false;
+}
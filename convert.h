@@ -0,0 +1,41 @@
+#ifndef CONVERT_H_INCLUDED
+#define CONVERT_H_INCLUDED
+
+#include "format.h"
+
+// video frame extraction
+#include <opencv2/core.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CONVERT_X86
+#endif
+
+// converts rows of packed 8 bit BGR (channels = 3) or BGRA (channels = 4)
+// pixels into packed 24 bit RGB
+typedef void (*ConvertRowsFunc)(const uint8_t *src, size_t srcPitch, int channels,
+                                uint8_t *dst, size_t dstPitch, int width, int height);
+
+// plain C++ version which works everywhere
+void convertRowsScalar(const uint8_t *src, size_t srcPitch, int channels,
+                       uint8_t *dst, size_t dstPitch, int width, int height);
+#ifdef CONVERT_X86
+// only to be called if the cpu supports the instruction set
+void convertRowsSSSE3(const uint8_t *src, size_t srcPitch, int channels,
+                      uint8_t *dst, size_t dstPitch, int width, int height);
+void convertRowsAVX2(const uint8_t *src, size_t srcPitch, int channels,
+                     uint8_t *dst, size_t dstPitch, int width, int height);
+#endif
+// fastest version the cpu supports, picked once at runtime
+extern ConvertRowsFunc convertRows;
+
+// convert an opencv frame into 24 bit RGB; rows are pitch bytes apart, or
+// tightly packed for 0
+void convertFrame(const cv::Mat &frame, uint8_t *pixelData, int pitch = 0);
+// convert an opencv frame into a frame of the given format; planar formats
+// need an even width and height and are always tightly packed
+void convertFrame(const cv::Mat &frame, PixelFormat, uint8_t *pixelData, int pitch = 0);
+
+#endif
@@ -0,0 +1,352 @@
+#include "decoder.h"
+#include "convert.h"
+#include "governor.h"
+#include "log.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+
+#include <math.h>
+
+// frames each segment decoder converts ahead of the consumer
+const size_t PARALLEL_BUFFERS = 4;
+// segments are never made shorter than this
+const size_t MIN_SEGMENT_FRAMES = 16;
+
+Decoder::Decoder(const std::string &file, size_t bufferCount, const std::vector<cv::Size> &requested,
+                 PixelFormat format, double rate)
+    : format(format), readyBuffers(bufferCount), freeBuffers(bufferCount)
+{
+    // open video; anything without a first frame is not one
+    cv::Mat firstFrame;
+    if (!vc.open(file) || !vc.read(firstFrame) || firstFrame.empty()) {
+        logWarning() << "failed to open video file " << file << "; make sure it exists and is valid\n";
+        count = 0;
+        finished = true;
+        return;
+    }
+    valid = true;
+
+    // get some properties
+    channels = firstFrame.channels();
+
+    vc.set(cv::CAP_PROP_POS_FRAMES, 0);
+
+    sourceWidth = vc.get(cv::CAP_PROP_FRAME_WIDTH);
+    sourceHeight = vc.get(cv::CAP_PROP_FRAME_HEIGHT);
+    framerate = sourceFramerate = vc.get(cv::CAP_PROP_FPS);
+    count = vc.get(cv::CAP_PROP_FRAME_COUNT);
+
+    // frame k of the resampled video is the one on screen at k / rate
+    if (rate > 0 && rate < framerate) {
+        step = framerate / rate;
+        count = ceil(count / step - 1e-6);
+        framerate = rate;
+    }
+
+    std::vector<cv::Size> wanted = requested;
+    if (wanted.empty()) {
+        wanted.push_back(cv::Size(sourceWidth, sourceHeight));
+    }
+    for (cv::Size size : wanted) {
+        size.width = std::min(size.width, sourceWidth);
+        size.height = std::min(size.height, sourceHeight);
+        if (evenSize(format)) {
+            size.width = std::max(2, size.width & ~1);
+            size.height = std::max(2, size.height & ~1);
+        }
+        if (std::find(sizes.begin(), sizes.end(), size) == sizes.end()) {
+            sizes.push_back(size);
+        }
+    }
+    std::sort(sizes.begin(), sizes.end(), [](const cv::Size &a, const cv::Size &b) { return a.area() > b.area(); });
+    width = sizes[0].width;
+    height = sizes[0].height;
+
+    buffers.resize(bufferCount);
+    for (PixelBuffer &buffer : buffers) {
+        for (const cv::Size &size : sizes) {
+            buffer.pixels.push_back(new uint8_t[frameBytes(format, size.width, size.height)]);
+        }
+        buffer.decoder = this;
+        freeBuffers.push(&buffer);
+    }
+}
+
+Decoder::~Decoder()
+{
+    stopping = true;
+    producer.notify();
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    if (taken) {
+        return;
+    }
+    for (PixelBuffer &buffer : buffers) {
+        for (uint8_t *pixels : buffer.pixels) {
+            delete[] pixels;
+        }
+    }
+}
+
+size_t Decoder::bufferBytes() const
+{
+    if (taken) {
+        return 0;
+    }
+
+    size_t bytes = 0;
+    for (const cv::Size &size : sizes) {
+        bytes += frameBytes(format, size.width, size.height);
+    }
+
+    return bytes * buffers.size();
+}
+
+void Decoder::start(bool loop, size_t loopStart)
+{
+    this->loop = loop;
+    this->loopStart = loopStart;
+    thread = std::thread(&Decoder::run, this);
+}
+
+void Decoder::startSegment(size_t begin, size_t end)
+{
+    this->begin = begin;
+    this->end = end;
+    start(false);
+}
+
+void Decoder::notifyOn(Parking *parking)
+{
+    consumer = parking;
+}
+
+std::vector<PixelBuffer*> Decoder::takeBuffers()
+{
+    std::vector<PixelBuffer*> handed;
+    PixelBuffer *buffer;
+    while (freeBuffers.pop(buffer)) {
+        delete[] buffer->pixels[0];
+        buffer->pixels[0] = nullptr;
+        handed.push_back(buffer);
+    }
+    taken = true;
+
+    return handed;
+}
+
+PixelBuffer *Decoder::pop()
+{
+    PixelBuffer *buffer;
+    return readyBuffers.pop(buffer) ? buffer : nullptr;
+}
+
+PixelBuffer *Decoder::wait()
+{
+    consumer->wait([this] { return !readyBuffers.empty() || finished; });
+    return pop();
+}
+
+void Decoder::waitUntil(std::chrono::steady_clock::time_point deadline)
+{
+    consumer->waitUntil(deadline, [this] { return !readyBuffers.empty() || finished; });
+}
+
+void Decoder::release(PixelBuffer *buffer)
+{
+    freeBuffers.push(buffer);
+    producer.notify();
+}
+
+void Decoder::run()
+{
+    backgroundThread();
+
+    cv::Mat frame, scaled;
+    size_t pos = begin;
+    size_t source = sourceFrame(pos); // frame the capture reads next
+    if (source > 0) {
+        vc.set(cv::CAP_PROP_POS_FRAMES, source);
+    }
+
+    while (!stopping && pos != end) {
+        PixelBuffer *buffer;
+        if (!freeBuffers.pop(buffer)) {
+            // every buffer is queued or being uploaded
+            producer.wait([this] { return stopping || !freeBuffers.empty(); });
+            continue;
+        }
+
+        if (loop && pos == count) {
+            pos = loopStart;
+            source = sourceFrame(pos);
+            vc.set(cv::CAP_PROP_POS_FRAMES, source);
+        }
+
+        // frames in between are decoded but never converted
+        bool read = true;
+        for (; read && source < sourceFrame(pos); source++) {
+            read = vc.grab();
+        }
+        if (read) {
+            vc >> frame;
+            source++;
+        } else {
+            frame.release();
+        }
+        if (frame.empty()) {
+            // the frame count reported by the container may be too high
+            if (pos > loopStart && end == SIZE_MAX) {
+                count = pos;
+            }
+            if (!loop || pos == loopStart) {
+                break;
+            }
+
+            pos = loopStart;
+            source = sourceFrame(pos);
+            vc.set(cv::CAP_PROP_POS_FRAMES, source);
+            vc >> frame;
+            source++;
+            if (frame.empty()) {
+                logWarning() << "failed to decode frame " << pos << "\n";
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < sizes.size(); i++) {
+            if (sizes[i].width != sourceWidth || sizes[i].height != sourceHeight) {
+                cv::resize(frame, scaled, sizes[i], 0, 0, cv::INTER_AREA);
+                convertFrame(scaled, format, buffer->pixels[i], i == 0 ? buffer->pitch : 0);
+            } else {
+                convertFrame(frame, format, buffer->pixels[i], i == 0 ? buffer->pitch : 0);
+            }
+        }
+        buffer->frame = pos++;
+        readyBuffers.push(buffer);
+        consumer->notify();
+    }
+
+    finished = true;
+    consumer->notify();
+}
+
+ParallelDecoder::ParallelDecoder(const std::string &file, int jobs, const std::vector<cv::Size> &sizes,
+                                 PixelFormat format, double rate)
+    : format(format)
+{
+    Decoder *first = new Decoder(file, PARALLEL_BUFFERS, sizes, format, rate);
+    if (!first->opened()) {
+        delete first;
+        frameCount = 0;
+        return;
+    }
+    this->sizes = first->sizes;
+    width = first->width;
+    height = first->height;
+    channels = first->channels;
+    sourceWidth = first->sourceWidth;
+    sourceHeight = first->sourceHeight;
+    framerate = first->framerate;
+    sourceFramerate = first->sourceFramerate;
+    frameCount = first->frameCount();
+
+    // seeking costs a little, so very short segments are not worth it
+    if (jobs <= 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    jobs = std::max<size_t>(1, std::min<size_t>(jobs, frameCount / MIN_SEGMENT_FRAMES));
+
+    // a file which vanished in between leaves fewer segments
+    decoders.push_back(first);
+    for (int job = 1; job < jobs; job++) {
+        Decoder *decoder = new Decoder(file, PARALLEL_BUFFERS, sizes, format, rate);
+        if (!decoder->opened()) {
+            delete decoder;
+            jobs = job;
+            break;
+        }
+        decoders.push_back(decoder);
+    }
+
+    // the last segment runs until the real end in case the count is wrong
+    size_t segment = frameCount / jobs;
+    for (int job = 0; job < jobs; job++) {
+        decoders[job]->notifyOn(&ready);
+        decoders[job]->startSegment(job * segment, job + 1 < jobs ? (job + 1) * segment : SIZE_MAX);
+    }
+}
+
+ParallelDecoder::~ParallelDecoder()
+{
+    for (Decoder *decoder : decoders) {
+        delete decoder;
+    }
+}
+
+PixelBuffer *ParallelDecoder::pop()
+{
+    // take turns so no segment falls behind
+    for (size_t i = 0; i < decoders.size(); i++) {
+        Decoder *decoder = decoders[(nextDecoder + i) % decoders.size()];
+        if (PixelBuffer *buffer = decoder->pop()) {
+            nextDecoder = (nextDecoder + i + 1) % decoders.size();
+            return buffer;
+        }
+    }
+
+    return nullptr;
+}
+
+PixelBuffer *ParallelDecoder::wait()
+{
+    for (;;) {
+        if (PixelBuffer *buffer = pop()) {
+            return buffer;
+        }
+        if (done()) {
+            return nullptr;
+        }
+
+        ready.wait([this] { return progress(); });
+    }
+}
+
+void ParallelDecoder::waitUntil(std::chrono::steady_clock::time_point deadline)
+{
+    ready.waitUntil(deadline, [this] { return progress(); });
+}
+
+bool ParallelDecoder::done() const
+{
+    // a decoder which is done pushed its last frame before
+    for (Decoder *decoder : decoders) {
+        if (!decoder->done() || decoder->hasFrames()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ParallelDecoder::progress() const
+{
+    bool done = true;
+    for (Decoder *decoder : decoders) {
+        if (decoder->hasFrames()) {
+            return true;
+        }
+        done = done && decoder->done();
+    }
+
+    return done;
+}
+
+void ParallelDecoder::release(PixelBuffer *buffer)
+{
+    buffer->decoder->release(buffer);
+}
@@ -0,0 +1,150 @@
+#ifndef DECODER_H_INCLUDED
+#define DECODER_H_INCLUDED
+
+#include "spscqueue.h"
+#include "format.h"
+
+// video frame extraction
+#include <opencv2/videoio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+class Decoder;
+
+// frame converted to the format of its decoder
+struct PixelBuffer {
+    std::vector<uint8_t*> pixels; // one per output size of the decoder
+    int pitch = 0; // bytes per row of the first size, 0 if tightly packed
+    void *owner = nullptr; // whatever taken buffers point into, e.g. a texture
+    size_t frame; // index of the frame in the video
+    Decoder *decoder; // decoder the buffer has to be released to
+};
+
+// owns the capture and decodes and converts frames on a background thread;
+// finished frames are handed over through a lock-free queue and have to be
+// given back with release() once they were uploaded
+class Decoder {
+public:
+    // every frame is converted once for each of the given sizes, scaled down
+    // with an area filter but never up; no sizes means the source size;
+    // formats which need even sizes round them down; a rate below the one
+    // of the video only yields the frames on screen at that rate, and frame
+    // indices, counts and the framerate are those of the resampled video
+    Decoder(const std::string &file, size_t bufferCount, const std::vector<cv::Size> &sizes = {},
+            PixelFormat format = PixelFormat::RGB24, double rate = 0);
+    ~Decoder();
+
+    // the video could be opened and has a first frame; a decoder which
+    // failed must not be started
+    bool opened() const { return valid; }
+
+    // start decoding at frame 0; with loop, decoding continues at loopStart
+    // after the last frame instead of ending
+    void start(bool loop, size_t loopStart = 0);
+    // decode frames [begin, end) only
+    void startSegment(size_t begin, size_t end);
+    // wake the given parking instead of the decoder's own when frames are
+    // ready; lets one consumer wait for several decoders
+    void notifyOn(Parking*);
+    // hands every buffer to the caller, who points it at memory of its own,
+    // e.g. a locked streaming texture, and passes it to release() to have a
+    // frame decoded into it; only for a single size and before start()
+    std::vector<PixelBuffer*> takeBuffers();
+
+    // next decoded frame or nullptr if none is ready
+    PixelBuffer *pop();
+    // next decoded frame, blocks until one is ready; nullptr at the end
+    PixelBuffer *wait();
+    // blocks until a frame is ready, the end was reached or the deadline
+    // passed
+    void waitUntil(std::chrono::steady_clock::time_point deadline);
+    void release(PixelBuffer*);
+
+    bool hasFrames() const { return !readyBuffers.empty(); }
+    // nothing will be decoded anymore
+    bool done() const { return finished; }
+
+    // frames in the video; may shrink once the real end has been reached
+    size_t frameCount() const { return count.load(); }
+    // memory of the decoded frames kept ahead; 0 once the buffers were taken
+    size_t bufferBytes() const;
+
+    // output sizes, largest first and without duplicates
+    std::vector<cv::Size> sizes;
+    int width, height, channels; // dimensions of the largest converted frames
+    int sourceWidth, sourceHeight;
+    double framerate, sourceFramerate;
+    PixelFormat format;
+
+private:
+    void run();
+    // frame of the source video shown as the given frame
+    size_t sourceFrame(size_t frame) const { return frame * step + 1e-6; }
+
+    cv::VideoCapture vc;
+    std::thread thread;
+    bool valid = false;
+    bool loop;
+    size_t loopStart;
+    size_t begin = 0, end = SIZE_MAX;
+    double step = 1; // source frames per decoded frame
+    std::atomic<size_t> count;
+    std::atomic<bool> stopping { false }, finished { false };
+
+    std::vector<PixelBuffer> buffers;
+    bool taken = false; // the pixels of the buffers belong to the caller
+    SpscQueue<PixelBuffer*> readyBuffers, freeBuffers;
+    Parking producer, ownConsumer;
+    Parking *consumer = &ownConsumer;
+};
+
+// decodes a whole video with several decoders working on consecutive
+// segments in parallel; frames arrive in no particular order
+class ParallelDecoder {
+public:
+    // jobs = 0 uses one decoder per core
+    ParallelDecoder(const std::string &file, int jobs, const std::vector<cv::Size> &sizes = {},
+                    PixelFormat format = PixelFormat::RGB24, double rate = 0);
+    ~ParallelDecoder();
+
+    // see Decoder; a decoder which failed yields no frames
+    bool opened() const { return !decoders.empty(); }
+
+    // next decoded frame of any segment or nullptr if none is ready
+    PixelBuffer *pop();
+    // next decoded frame of any segment, blocks until one is ready; nullptr
+    // once every segment is done
+    PixelBuffer *wait();
+    // sleeps until a frame is ready, every segment is done or the deadline
+    // has passed
+    void waitUntil(std::chrono::steady_clock::time_point deadline);
+    void release(PixelBuffer*);
+
+    // every segment is done and all of its frames were taken
+    bool done() const;
+
+    // frames in the video as reported by the container
+    size_t frameCount;
+
+    std::vector<cv::Size> sizes; // see Decoder
+    int width, height, channels;
+    int sourceWidth, sourceHeight;
+    double framerate, sourceFramerate;
+    PixelFormat format;
+
+private:
+    // a frame is ready or every segment is done
+    bool progress() const;
+
+    std::vector<Decoder*> decoders;
+    size_t nextDecoder = 0;
+    Parking ready;
+};
+
+#endif
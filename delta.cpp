@@ -0,0 +1,150 @@
+#include "delta.h"
+#include "log.h"
+
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+DeltaEncoder::DeltaEncoder(int width, int height, int threshold)
+    : width(width), height(height), threshold(threshold)
+{
+}
+
+DeltaFrame DeltaEncoder::encode(const uint8_t *pixels)
+{
+    DeltaFrame frame;
+    size_t pitch = width * 3;
+
+    if (reference.empty() || sinceKeyframe >= DELTA_KEYFRAME_INTERVAL) {
+        frame.rects.push_back({ 0, 0, width, height });
+        frame.pixels.assign(pixels, pixels + pitch * height);
+        reference = frame.pixels;
+        sinceKeyframe = 1;
+        return frame;
+    }
+
+    int tilesX = (width + DELTA_TILE_SIZE - 1) / DELTA_TILE_SIZE;
+    for (int y = 0; y < height; y += DELTA_TILE_SIZE) {
+        int tileHeight = std::min(DELTA_TILE_SIZE, height - y);
+
+        // changed tiles next to each other are merged into a single rect
+        int runStart = -1;
+        for (int tx = 0; tx <= tilesX; tx++) {
+            bool changed = false;
+            if (tx < tilesX) {
+                SDL_Rect tile { tx * DELTA_TILE_SIZE, y, std::min(DELTA_TILE_SIZE, width - tx * DELTA_TILE_SIZE), tileHeight };
+                changed = tileChanged(pixels, tile);
+            }
+
+            if (changed && runStart < 0) {
+                runStart = tx;
+            } else if (!changed && runStart >= 0) {
+                SDL_Rect rect { runStart * DELTA_TILE_SIZE, y, std::min(tx * DELTA_TILE_SIZE, width) - runStart * DELTA_TILE_SIZE, tileHeight };
+                frame.rects.push_back(rect);
+                for (int row = rect.y; row < rect.y + rect.h; row++) {
+                    size_t offset = row * pitch + rect.x * 3;
+                    frame.pixels.insert(frame.pixels.end(), pixels + offset, pixels + offset + rect.w * 3);
+                    memcpy(&reference[offset], pixels + offset, rect.w * 3);
+                }
+                runStart = -1;
+            }
+        }
+    }
+
+    frame.pixels.shrink_to_fit();
+    sinceKeyframe++;
+    return frame;
+}
+
+bool DeltaEncoder::tileChanged(const uint8_t *pixels, const SDL_Rect &tile) const
+{
+    size_t pitch = width * 3;
+    for (int row = tile.y; row < tile.y + tile.h; row++) {
+        const uint8_t *a = pixels + row * pitch + tile.x * 3;
+        const uint8_t *b = &reference[row * pitch + tile.x * 3];
+        if (memcmp(a, b, tile.w * 3) == 0) {
+            continue;
+        }
+
+        for (int i = 0; i < tile.w * 3; i++) {
+            if (abs(a[i] - b[i]) > threshold) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+DeltaStore::DeltaStore(const RenderContext &rc, int width, int height, std::vector<DeltaFrame> &&deltas)
+    : sdlr(rc.sdlr), width(width), height(height)
+{
+    for (DeltaFrame &frame : deltas) {
+        if (frame.rects.empty() && !frames.empty()) {
+            frames.back().duration += frame.duration;
+        } else {
+            frames.push_back(std::move(frame));
+        }
+    }
+}
+
+DeltaStore::~DeltaStore()
+{
+    if (sdlTexture) {
+        SDL_DestroyTexture(sdlTexture);
+    }
+}
+
+bool DeltaStore::load(std::chrono::steady_clock::time_point until)
+{
+    if (sdlTexture) {
+        return false;
+    }
+
+    sdlTexture = SDL_CreateTexture(sdlr, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (!sdlTexture) {
+        logWarning() << "failed to create streaming texture: " << SDL_GetError() << "\n";
+    }
+
+    return false;
+}
+
+bool DeltaStore::next()
+{
+    cursor = cursor + 1 < frames.size() ? cursor + 1 : 0;
+
+    const DeltaFrame &frame = frames[cursor];
+    const uint8_t *pixels = frame.pixels.data();
+    for (const SDL_Rect &rect : frame.rects) {
+        SDL_UpdateTexture(sdlTexture, &rect, pixels, rect.w * 3);
+        pixels += rect.w * rect.h * 3;
+    }
+
+    return true;
+}
+
+SDL_Texture *DeltaStore::texture(int width, int height)
+{
+    return sdlTexture;
+}
+
+int DeltaStore::duration()
+{
+    return frames[cursor].duration;
+}
+
+size_t DeltaStore::residentBytes() const
+{
+    return bytes() + textureMemory(sdlTexture);
+}
+
+size_t DeltaStore::bytes() const
+{
+    size_t bytes = 0;
+    for (const DeltaFrame &frame : frames) {
+        bytes += frame.pixels.size() + frame.rects.size() * sizeof(SDL_Rect);
+    }
+
+    return bytes;
+}
@@ -0,0 +1,68 @@
+#ifndef DELTA_H_INCLUDED
+#define DELTA_H_INCLUDED
+
+#include "video.h"
+
+#include <stdint.h>
+
+// frames are compared in square tiles of this many pixels
+const int DELTA_TILE_SIZE = 64;
+// a full frame is stored at least this often
+const size_t DELTA_KEYFRAME_INTERVAL = 300;
+
+// the parts of a frame which changed since the previous frame
+struct DeltaFrame {
+    std::vector<SDL_Rect> rects;
+    std::vector<uint8_t> pixels; // pixels of all rects one after another, rows tightly packed
+    int duration = 1; // in frame periods
+};
+
+// turns consecutive frames of one sequence into delta frames; tiles are
+// compared against what is shown at that point, so small changes below the
+// threshold never add up
+class DeltaEncoder {
+public:
+    // threshold is the largest difference of a color channel which still
+    // counts as unchanged
+    DeltaEncoder(int width, int height, int threshold);
+
+    // encodes a frame of tightly packed 24 bit RGB; the first frame and
+    // every DELTA_KEYFRAME_INTERVAL-th one are stored completely
+    DeltaFrame encode(const uint8_t *pixels);
+
+private:
+    bool tileChanged(const uint8_t *pixels, const SDL_Rect &tile) const;
+
+    int width, height, threshold;
+    std::vector<uint8_t> reference; // what the texture shows after the last frame
+    size_t sinceKeyframe = 0;
+};
+
+// plays delta frames by updating only the changed rects of a single
+// streaming texture; frames without changes only extend the previous one
+class DeltaStore : public FrameStore {
+public:
+    // frames[0] has to be a full frame; the texture is created by the first
+    // call to load(), so the store can be filled without the renderer
+    DeltaStore(const RenderContext&, int width, int height, std::vector<DeltaFrame> &&deltas);
+    ~DeltaStore();
+
+    bool next() override;
+    SDL_Texture *texture(int width, int height) override;
+    int duration() override;
+    size_t residentBytes() const override;
+    bool load(std::chrono::steady_clock::time_point until) override;
+    bool ready() const override { return sdlTexture; }
+
+    // memory used by all delta frames
+    size_t bytes() const;
+
+private:
+    std::vector<DeltaFrame> frames;
+    SDL_Renderer *sdlr;
+    int width, height;
+    SDL_Texture *sdlTexture = nullptr;
+    size_t cursor = SIZE_MAX;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "filetype.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// a transport stream packet starts with a sync byte
+const size_t TS_PACKET_SIZE = 188;
+
+bool hasVideoSignature(const std::string &file)
+{
+    FILE *f = fopen(file.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+
+    unsigned char header[TS_PACKET_SIZE + 1] = {};
+    size_t size = fread(header, 1, sizeof(header), f);
+    fclose(f);
+    if (size < 12) {
+        return false;
+    }
+
+    static const unsigned char ebml[] = { 0x1a, 0x45, 0xdf, 0xa3 };
+    static const unsigned char asf[] = { 0x30, 0x26, 0xb2, 0x75, 0x8e, 0x66, 0xcf, 0x11 };
+    static const unsigned char mpegPack[] = { 0x00, 0x00, 0x01, 0xba };
+    static const unsigned char mpegSequence[] = { 0x00, 0x00, 0x01, 0xb3 };
+
+    // QuickTime files may start with any of these atoms instead of ftyp
+    const char *atom = (const char*)header + 4;
+    bool isoMedia = memcmp(atom, "ftyp", 4) == 0 || memcmp(atom, "moov", 4) == 0
+        || memcmp(atom, "mdat", 4) == 0 || memcmp(atom, "free", 4) == 0
+        || memcmp(atom, "wide", 4) == 0 || memcmp(atom, "skip", 4) == 0;
+
+    return memcmp(header, ebml, sizeof(ebml)) == 0
+        || isoMedia
+        || (memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "AVI ", 4) == 0)
+        || memcmp(header, mpegPack, sizeof(mpegPack)) == 0
+        || memcmp(header, mpegSequence, sizeof(mpegSequence)) == 0
+        || (size > TS_PACKET_SIZE && header[0] == 0x47 && header[TS_PACKET_SIZE] == 0x47)
+        || memcmp(header, "OggS", 4) == 0
+        || memcmp(header, "FLV", 3) == 0
+        || memcmp(header, asf, sizeof(asf)) == 0;
+}
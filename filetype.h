@@ -0,0 +1,12 @@
+#ifndef FILETYPE_H_INCLUDED
+#define FILETYPE_H_INCLUDED
+
+#include <string>
+
+// whether the file starts with the signature of a container OpenCV reads
+// videos from: Matroska/WebM, MP4/QuickTime, AVI, MPEG program and
+// transport streams, Ogg, FLV or ASF; only the first bytes are read, so a
+// broken file still passes and is only noticed while it is prepared
+bool hasVideoSignature(const std::string &file);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef FORMAT_H_INCLUDED
+#define FORMAT_H_INCLUDED
+
+#include <stddef.h>
+
+// how the pixels of a stored frame are laid out
+enum class PixelFormat {
+    RGB24, // packed 8 bit RGB
+    IYUV, // planar Y, U and V, chroma at half resolution in both directions
+    NV12, // planar Y followed by interleaved U and V at half resolution
+    RGB565, // packed 16 bit RGB, ordered dithering
+    XRGB32 // packed B, G, R and an unused byte in memory order, which most
+           // renderers take as is; only used for streamed frames
+};
+
+// bytes of a tightly packed frame
+size_t frameBytes(PixelFormat, int width, int height);
+// bytes in a row of the first plane
+int framePitch(PixelFormat, int width);
+// whether frames need an even width and height
+bool evenSize(PixelFormat);
+
+// name used on the command line; XRGB32 can not be picked there
+const char *formatName(PixelFormat);
+// returns false if there is no format of that name
+bool parseFormat(const char *name, PixelFormat*);
+
+#endif
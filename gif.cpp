@@ -0,0 +1,589 @@
+#include "gif.h"
+#include "log.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include <stdio.h>
+#include <string.h>
+
+// a delay this short is treated as 1/10 s, as browsers do
+const int GIF_MIN_DELAY = 2;
+const int GIF_DEFAULT_DELAY = 10;
+
+// bounds checked reading of the file contents
+struct GifReader {
+    const uint8_t *data;
+    size_t size, pos;
+    bool ok;
+
+    uint8_t byte()
+    {
+        if (pos >= size) {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    uint16_t word()
+    {
+        uint16_t low = byte();
+        return low | byte() << 8;
+    }
+};
+
+// image block of the file, before it is drawn onto the canvas
+struct GifImage {
+    int left, top, width, height;
+    bool interlaced;
+    int palette; // index into the tables of the file, -1 for the global one
+    int transparent; // color index which is not drawn, -1 for none
+    int disposal; // what happens to the canvas after the frame was shown
+    int delay; // in 1/100 s
+    int minCodeSize;
+    std::vector<uint8_t> data; // LZW compressed indices
+};
+
+enum GifDisposal {
+    DISPOSE_NONE = 1,
+    DISPOSE_BACKGROUND = 2,
+    DISPOSE_PREVIOUS = 3
+};
+
+static std::vector<uint32_t> readPalette(GifReader &reader, int size)
+{
+    std::vector<uint32_t> palette(256, 0xff000000);
+    for (int i = 0; i < size; i++) {
+        uint32_t r = reader.byte(), g = reader.byte(), b = reader.byte();
+        palette[i] = 0xff000000 | r << 16 | g << 8 | b;
+    }
+
+    return palette;
+}
+
+static void readSubBlocks(GifReader &reader, std::vector<uint8_t> *out)
+{
+    for (uint8_t size = reader.byte(); size > 0 && reader.ok; size = reader.byte()) {
+        if (reader.pos + size > reader.size) {
+            reader.ok = false;
+            return;
+        }
+        if (out) {
+            out->insert(out->end(), reader.data + reader.pos, reader.data + reader.pos + size);
+        }
+        reader.pos += size;
+    }
+}
+
+// decodes as many indices as fit into out; broken data leaves the rest as it
+// was, like most viewers do
+static void decodeLzw(const std::vector<uint8_t> &data, int minCodeSize, uint8_t *out, size_t outSize)
+{
+    if (minCodeSize < 1 || minCodeSize > 11) {
+        return;
+    }
+
+    const int clear = 1 << minCodeSize, end = clear + 1;
+    uint16_t prefix[4096];
+    uint8_t suffix[4096];
+    uint8_t stack[4097];
+    for (int code = 0; code < clear; code++) {
+        suffix[code] = code;
+    }
+
+    int codeSize = minCodeSize + 1, next = clear + 2;
+    int previous = -1;
+    uint8_t first = 0;
+    uint32_t bits = 0;
+    int bitCount = 0;
+    size_t pos = 0, written = 0;
+
+    while (written < outSize) {
+        while (bitCount < codeSize) {
+            if (pos >= data.size()) {
+                return;
+            }
+            bits |= (uint32_t)data[pos++] << bitCount;
+            bitCount += 8;
+        }
+        int code = bits & ((1 << codeSize) - 1);
+        bits >>= codeSize;
+        bitCount -= codeSize;
+
+        if (code == clear) {
+            codeSize = minCodeSize + 1;
+            next = clear + 2;
+            previous = -1;
+            continue;
+        }
+        if (code == end) {
+            return;
+        }
+
+        if (previous < 0) {
+            if (code > clear) {
+                return;
+            }
+            out[written++] = first = code;
+            previous = code;
+            continue;
+        }
+
+        // strings are built back to front
+        int sp = 0, current = code;
+        if (code >= next) {
+            if (code > next) {
+                return;
+            }
+            stack[sp++] = first;
+            current = previous;
+        }
+        while (current > end) {
+            stack[sp++] = suffix[current];
+            current = prefix[current];
+        }
+        stack[sp++] = first = current;
+
+        while (sp > 0 && written < outSize) {
+            out[written++] = stack[--sp];
+        }
+
+        if (next < 4096) {
+            prefix[next] = previous;
+            suffix[next] = first;
+            next++;
+            if (next == 1 << codeSize && codeSize < 12) {
+                codeSize++;
+            }
+        }
+        previous = code;
+    }
+}
+
+// row of the image which the given decoded row belongs to
+static int interlacedRow(int row, int height)
+{
+    const int starts[] = { 0, 4, 2, 1 }, steps[] = { 8, 8, 4, 2 };
+    for (int pass = 0; pass < 4; pass++) {
+        int rows = (height - starts[pass] + steps[pass] - 1) / steps[pass];
+        if (row < rows) {
+            return starts[pass] + row * steps[pass];
+        }
+        row -= rows;
+    }
+
+    return row;
+}
+
+static int gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+// assigns palette indices to composed frames; colors are added to the
+// current palette while it has room, so frames keep sharing one
+class PaletteBuilder {
+public:
+    PaletteBuilder(GifAnimation *animation) : animation(animation) {}
+
+    void index(const std::vector<uint32_t> &canvas, GifFrame *frame)
+    {
+        frame->indices.resize(canvas.size());
+        if (tryIndex(canvas, frame)) {
+            return;
+        }
+
+        // a fresh palette for this frame
+        lookup.clear();
+        current = SIZE_MAX;
+        if (tryIndex(canvas, frame)) {
+            return;
+        }
+
+        // too many colors for a single frame, reduce them to 3-3-2 bits
+        animation->palettes.pop_back();
+        lookup.clear();
+        current = SIZE_MAX;
+        std::vector<uint32_t> palette(256);
+        for (int i = 0; i < 256; i++) {
+            palette[i] = 0xff000000 | (i >> 5) * 255 / 7 << 16 | (i >> 2 & 7) * 255 / 7 << 8 | (i & 3) * 255 / 3;
+        }
+        animation->palettes.push_back(palette);
+        frame->palette = animation->palettes.size() - 1;
+        for (size_t i = 0; i < canvas.size(); i++) {
+            uint32_t color = canvas[i];
+            frame->indices[i] = (color >> 16 & 0xe0) | (color >> 11 & 0x1c) | (color >> 6 & 0x03);
+        }
+        logInfo() << "a frame has more than 256 colors and was reduced to 3-3-2 bits\n";
+    }
+
+private:
+    bool tryIndex(const std::vector<uint32_t> &canvas, GifFrame *frame)
+    {
+        if (current == SIZE_MAX) {
+            animation->palettes.push_back(std::vector<uint32_t>());
+            current = animation->palettes.size() - 1;
+        }
+        std::vector<uint32_t> &palette = animation->palettes[current];
+        size_t colors = palette.size();
+
+        uint32_t lastColor = 0;
+        int lastIndex = -1;
+        for (size_t i = 0; i < canvas.size(); i++) {
+            uint32_t color = canvas[i];
+            if (lastIndex < 0 || color != lastColor) {
+                auto found = lookup.find(color);
+                if (found != lookup.end()) {
+                    lastIndex = found->second;
+                } else if (palette.size() < 256) {
+                    lastIndex = palette.size();
+                    lookup[color] = lastIndex;
+                    palette.push_back(color);
+                } else {
+                    // forget the colors this frame added
+                    for (size_t added = colors; added < palette.size(); added++) {
+                        lookup.erase(palette[added]);
+                    }
+                    palette.resize(colors);
+                    return false;
+                }
+                lastColor = color;
+            }
+            frame->indices[i] = lastIndex;
+        }
+
+        frame->palette = current;
+        return true;
+    }
+
+    GifAnimation *animation;
+    std::unordered_map<uint32_t, uint8_t> lookup; // colors of the current palette
+    size_t current = SIZE_MAX;
+};
+
+bool isGif(const std::string &file)
+{
+    FILE *f = fopen(file.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+
+    char signature[6];
+    bool gif = fread(signature, sizeof(signature), 1, f) == 1
+        && (memcmp(signature, "GIF87a", 6) == 0 || memcmp(signature, "GIF89a", 6) == 0);
+    fclose(f);
+    return gif;
+}
+
+bool loadGif(const std::string &file, GifAnimation *animation)
+{
+    std::vector<uint8_t> contents;
+    FILE *f = fopen(file.c_str(), "rb");
+    if (!f) {
+        logError() << "failed to open GIF file " << file << "\n";
+        return false;
+    }
+    uint8_t chunk[65536];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), f)) > 0;) {
+        contents.insert(contents.end(), chunk, chunk + n);
+    }
+    fclose(f);
+
+    GifReader reader { contents.data(), contents.size(), 6, contents.size() >= 13 };
+
+    // logical screen
+    int width = reader.word(), height = reader.word();
+    uint8_t flags = reader.byte();
+    int background = reader.byte();
+    reader.byte();
+
+    std::vector<std::vector<uint32_t>> tables;
+    std::vector<uint32_t> global;
+    bool hasGlobal = flags & 0x80;
+    if (hasGlobal) {
+        global = readPalette(reader, 2 << (flags & 7));
+    }
+
+    // every image block with the graphic control extension before it
+    std::vector<GifImage> images;
+    int transparent = -1, disposal = 0, delay = 0;
+    while (reader.ok) {
+        uint8_t block = reader.byte();
+        if (block == 0x3b || !reader.ok) {
+            break;
+        }
+
+        if (block == 0x21) {
+            uint8_t label = reader.byte();
+            if (label == 0xf9) {
+                reader.byte();
+                uint8_t control = reader.byte();
+                delay = reader.word();
+                int index = reader.byte();
+                disposal = control >> 2 & 7;
+                transparent = control & 1 ? index : -1;
+                readSubBlocks(reader, nullptr);
+            } else {
+                readSubBlocks(reader, nullptr);
+            }
+        } else if (block == 0x2c) {
+            GifImage image;
+            image.left = reader.word();
+            image.top = reader.word();
+            image.width = reader.word();
+            image.height = reader.word();
+            uint8_t imageFlags = reader.byte();
+            image.interlaced = imageFlags & 0x40;
+            image.palette = -1;
+            if (imageFlags & 0x80) {
+                tables.push_back(readPalette(reader, 2 << (imageFlags & 7)));
+                image.palette = tables.size() - 1;
+            }
+            image.transparent = transparent;
+            image.disposal = disposal;
+            image.delay = delay;
+            image.minCodeSize = reader.byte();
+            readSubBlocks(reader, &image.data);
+            if (reader.ok) {
+                images.push_back(std::move(image));
+            }
+
+            // the control extension only applies to the next image
+            transparent = -1;
+            disposal = 0;
+            delay = 0;
+        } else {
+            break;
+        }
+    }
+
+    if (width <= 0 || height <= 0 || images.empty()) {
+        logError() << "failed to read GIF file " << file << "\n";
+        return false;
+    }
+    if (!reader.ok) {
+        logWarning() << "GIF file " << file << " is truncated, keeping " << images.size() << " frames\n";
+    }
+
+    if (!hasGlobal) {
+        global.assign(256, 0xff000000);
+    }
+    uint32_t backgroundColor = hasGlobal ? global[background] : 0xff000000;
+
+    // frames are composed in colors since their tables may differ, but if
+    // they all use the global one, the indices can be kept as they are
+    bool indexed = std::all_of(images.begin(), images.end(), [](const GifImage &image) { return image.palette < 0; });
+
+    animation->width = width;
+    animation->height = height;
+    animation->palettes.clear();
+    animation->frames.clear();
+    if (indexed) {
+        animation->palettes.push_back(global);
+    }
+
+    size_t pixels = (size_t)width * height;
+    std::vector<uint8_t> indexCanvas(indexed ? pixels : 0, background);
+    std::vector<uint32_t> colorCanvas(indexed ? 0 : pixels, backgroundColor);
+    std::vector<uint8_t> savedIndices;
+    std::vector<uint32_t> savedColors;
+    std::vector<uint8_t> decoded;
+    PaletteBuilder palettes(animation);
+
+    for (const GifImage &image : images) {
+        if (image.disposal == DISPOSE_PREVIOUS) {
+            savedIndices = indexCanvas;
+            savedColors = colorCanvas;
+        }
+
+        decoded.assign((size_t)image.width * image.height, image.transparent >= 0 ? image.transparent : 0);
+        decodeLzw(image.data, image.minCodeSize, decoded.data(), decoded.size());
+
+        // parts outside of the logical screen are cut off
+        const std::vector<uint32_t> &palette = image.palette < 0 ? global : tables[image.palette];
+        for (int row = 0; row < image.height; row++) {
+            int y = image.top + (image.interlaced ? interlacedRow(row, image.height) : row);
+            if (y >= height) {
+                continue;
+            }
+            const uint8_t *src = &decoded[(size_t)row * image.width];
+            for (int x = 0; x < image.width && image.left + x < width; x++) {
+                if (src[x] == image.transparent) {
+                    continue;
+                }
+                size_t dst = (size_t)y * width + image.left + x;
+                if (indexed) {
+                    indexCanvas[dst] = src[x];
+                } else {
+                    colorCanvas[dst] = palette[src[x]];
+                }
+            }
+        }
+
+        int delay = image.delay < GIF_MIN_DELAY ? GIF_DEFAULT_DELAY : image.delay;
+
+        // repeated frames only make the previous one stay longer
+        GifFrame frame;
+        if (indexed) {
+            frame.indices = indexCanvas;
+            frame.palette = 0;
+        } else {
+            palettes.index(colorCanvas, &frame);
+        }
+        if (!animation->frames.empty() && animation->frames.back().palette == frame.palette
+            && animation->frames.back().indices == frame.indices) {
+            animation->frames.back().duration += delay;
+        } else {
+            frame.duration = delay;
+            animation->frames.push_back(std::move(frame));
+        }
+
+        if (image.disposal == DISPOSE_BACKGROUND) {
+            for (int y = image.top; y < std::min(height, image.top + image.height); y++) {
+                for (int x = image.left; x < std::min(width, image.left + image.width); x++) {
+                    if (indexed) {
+                        indexCanvas[(size_t)y * width + x] = background;
+                    } else {
+                        colorCanvas[(size_t)y * width + x] = backgroundColor;
+                    }
+                }
+            }
+        } else if (image.disposal == DISPOSE_PREVIOUS) {
+            indexCanvas.swap(savedIndices);
+            colorCanvas.swap(savedColors);
+        }
+    }
+
+    // frame durations become multiples of a common delay
+    int unit = 0;
+    for (const GifFrame &frame : animation->frames) {
+        unit = gcd(unit, frame.duration);
+    }
+    for (GifFrame &frame : animation->frames) {
+        frame.duration /= unit;
+    }
+    animation->delayUnit = unit;
+
+    for (std::vector<uint32_t> &palette : animation->palettes) {
+        palette.resize(256, 0xff000000);
+    }
+
+    return true;
+}
+
+GifStore::GifStore(const RenderContext &rc, GifAnimation &&animation)
+    : animation(std::move(animation)), sdlr(rc.sdlr)
+{
+    for (size_t &frame : slotFrames) {
+        frame = SIZE_MAX;
+    }
+}
+
+GifStore::~GifStore()
+{
+    for (SDL_Texture *texture : slots) {
+        if (texture) {
+            SDL_DestroyTexture(texture);
+        }
+    }
+}
+
+bool GifStore::load(std::chrono::steady_clock::time_point until)
+{
+    for (SDL_Texture *&texture : slots) {
+        if (texture) {
+            continue;
+        }
+        texture = SDL_CreateTexture(sdlr, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                    animation.width, animation.height);
+        if (!texture) {
+            logWarning() << "failed to create streaming texture: " << SDL_GetError() << "\n";
+            return false;
+        }
+    }
+
+    return false;
+}
+
+bool GifStore::next()
+{
+    cursor = cursor + 1 < animation.frames.size() ? cursor + 1 : 0;
+    tick++;
+
+    // short loops stay expanded
+    size_t lru = 0;
+    for (size_t i = 0; i < GIF_SLOTS; i++) {
+        if (slotFrames[i] == cursor) {
+            slotUsed[i] = tick;
+            current = slots[i];
+            return true;
+        }
+        if (slotUsed[i] < slotUsed[lru]) {
+            lru = i;
+        }
+    }
+
+    expand(animation.frames[cursor], slots[lru]);
+    slotFrames[lru] = cursor;
+    slotUsed[lru] = tick;
+    current = slots[lru];
+    return true;
+}
+
+SDL_Texture *GifStore::texture(int width, int height)
+{
+    return current;
+}
+
+int GifStore::duration()
+{
+    return animation.frames[cursor].duration;
+}
+
+size_t GifStore::residentBytes() const
+{
+    size_t bytes = this->bytes();
+    for (SDL_Texture *texture : slots) {
+        bytes += textureMemory(texture);
+    }
+
+    return bytes;
+}
+
+size_t GifStore::bytes() const
+{
+    size_t bytes = animation.palettes.size() * 256 * sizeof(uint32_t);
+    for (const GifFrame &frame : animation.frames) {
+        bytes += frame.indices.size();
+    }
+
+    return bytes;
+}
+
+void GifStore::expand(const GifFrame &frame, SDL_Texture *texture)
+{
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0) {
+        logError() << "failed to lock streaming texture: " << SDL_GetError() << "\n";
+        return;
+    }
+
+    const uint32_t *palette = animation.palettes[frame.palette].data();
+    const uint8_t *src = frame.indices.data();
+    for (int y = 0; y < animation.height; y++) {
+        uint32_t *dst = (uint32_t*)((uint8_t*)pixels + (size_t)y * pitch);
+        for (int x = 0; x < animation.width; x++) {
+            dst[x] = palette[*src++];
+        }
+    }
+
+    SDL_UnlockTexture(texture);
+}
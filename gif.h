@@ -0,0 +1,67 @@
+#ifndef GIF_H_INCLUDED
+#define GIF_H_INCLUDED
+
+#include "video.h"
+
+#include <string>
+
+#include <stdint.h>
+
+// streaming textures the indexed frames are expanded into
+const size_t GIF_SLOTS = 3;
+
+// a GIF frame after applying disposal and transparency, as 8 bit indices
+// into one of the palettes of the animation
+struct GifFrame {
+    std::vector<uint8_t> indices;
+    size_t palette;
+    int duration; // in delay units of the animation
+};
+
+struct GifAnimation {
+    int width, height;
+    // 256 colors as ARGB8888 each; frames usually share the first one
+    std::vector<std::vector<uint32_t>> palettes;
+    std::vector<GifFrame> frames;
+    int delayUnit; // greatest common divisor of all delays, in 1/100 s
+};
+
+// whether the file starts with a GIF signature
+bool isGif(const std::string &file);
+// decodes and composes every frame; returns false if the file is broken
+bool loadGif(const std::string &file, GifAnimation*);
+
+// keeps frames as indices and only expands them to ARGB while uploading
+// into a small pool of streaming textures, which take the place of the
+// least recently shown frame
+class GifStore : public FrameStore {
+public:
+    // the slots are created by the first call to load(), so the store can
+    // be filled without the renderer
+    GifStore(const RenderContext&, GifAnimation &&animation);
+    ~GifStore();
+
+    bool next() override;
+    SDL_Texture *texture(int width, int height) override;
+    int duration() override;
+    size_t residentBytes() const override;
+    bool load(std::chrono::steady_clock::time_point until) override;
+    bool ready() const override { return slots[GIF_SLOTS - 1]; }
+
+    // memory used by the indexed frames and palettes
+    size_t bytes() const;
+
+private:
+    void expand(const GifFrame&, SDL_Texture*);
+
+    GifAnimation animation;
+    SDL_Renderer *sdlr;
+    SDL_Texture *slots[GIF_SLOTS] = {};
+    size_t slotFrames[GIF_SLOTS]; // frame each slot shows
+    uint64_t slotUsed[GIF_SLOTS] = {};
+    SDL_Texture *current = nullptr;
+    size_t cursor = SIZE_MAX;
+    uint64_t tick = 0;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "governor.h"
+#include "log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+static bool idleThreads = false;
+
+void setIdleThreads(bool enabled)
+{
+    idleThreads = enabled;
+}
+
+void backgroundThread()
+{
+    if (!idleThreads) {
+        return;
+    }
+
+    // SCHED_IDLE only runs when a core would idle otherwise; without it the
+    // lowest nice value still leaves most of the cpu to everything else
+    sched_param param = {};
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+        setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+    }
+}
+
+static std::chrono::steady_clock::duration processCpuTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+static std::string readLine(const std::string &file)
+{
+    std::ifstream in(file);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+PowerGovernor::PowerGovernor(FrameScheduler *scheduler, int cpuBudget)
+    : scheduler(scheduler), cpuBudget(cpuBudget)
+{
+    sampled = std::chrono::steady_clock::now();
+    cpuTime = processCpuTime();
+}
+
+void PowerGovernor::update()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - sampled < std::chrono::seconds(GOVERNOR_INTERVAL)) {
+        return;
+    }
+
+    SystemLoad load;
+    sample(&load);
+    double wanted = target(load);
+
+    // backing off happens at once, going back up a step per interval, so
+    // a short break in a build does not make the rate jump back and forth
+    current = wanted < current ? wanted : std::min(wanted, current + RAMP_STEP);
+    scheduler->setThrottle(current);
+
+    if (current == wanted && current != announced) {
+        logInfo() << "presenting at " << (int)(current * 100 + 0.5) << "% of the framerate (load "
+            << load.load << " per core, " << (int)load.cpu << "% cpu"
+            << (load.battery ? ", on battery at " + std::to_string(load.charge) + "%" : "") << ")\n";
+        announced = current;
+    }
+}
+
+void PowerGovernor::sample(SystemLoad *load)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration cpu = processCpuTime();
+    load->cpu = 100.0 * std::chrono::duration<double>(cpu - cpuTime).count()
+        / std::chrono::duration<double>(now - sampled).count();
+    sampled = now;
+    cpuTime = cpu;
+
+    std::ifstream loadavg("/proc/loadavg");
+    double average;
+    if (loadavg >> average) {
+        load->load = average / std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    }
+
+    // every battery is listed with its state; mains adapters are ignored
+    const std::string supplies = "/sys/class/power_supply/";
+    DIR *dir = opendir(supplies.c_str());
+    if (!dir) {
+        return;
+    }
+    while (dirent *entry = readdir(dir)) {
+        std::string supply = supplies + entry->d_name + "/";
+        if (entry->d_name[0] == '.' || readLine(supply + "type") != "Battery") {
+            continue;
+        }
+
+        if (readLine(supply + "status") == "Discharging") {
+            load->battery = true;
+        }
+        std::string capacity = readLine(supply + "capacity");
+        if (!capacity.empty()) {
+            load->charge = std::min(load->charge, atoi(capacity.c_str()));
+        }
+    }
+    closedir(dir);
+}
+
+double PowerGovernor::target(const SystemLoad &load) const
+{
+    double wanted = 1;
+    if (load.battery) {
+        wanted = load.charge <= LOW_BATTERY ? MIN_RATE_FACTOR : 0.5;
+    }
+
+    // more runnable threads than cores; xanim gets out of their way in
+    // proportion
+    if (load.load > 1) {
+        wanted = std::min(wanted, 1 / load.load);
+    }
+
+    // the cpu time scales about linearly with the rate; close to the budget
+    // the rate is kept where it is
+    if (cpuBudget > 0 && load.cpu > cpuBudget) {
+        wanted = std::min(wanted, current * cpuBudget / load.cpu);
+    } else if (cpuBudget > 0 && load.cpu > cpuBudget * 0.9) {
+        wanted = std::min(wanted, current);
+    }
+
+    return std::max(MIN_RATE_FACTOR, wanted);
+}
@@ -0,0 +1,59 @@
+#ifndef GOVERNOR_H_INCLUDED
+#define GOVERNOR_H_INCLUDED
+
+#include "scheduler.h"
+
+#include <chrono>
+
+// seconds between two looks at the system
+const int GOVERNOR_INTERVAL = 1;
+// share of the framerate the governor never goes below
+const double MIN_RATE_FACTOR = 0.25;
+// share of the framerate the rate goes back up by per interval
+const double RAMP_STEP = 0.1;
+// battery charge in percent below which playback slows down further
+const int LOW_BATTERY = 20;
+
+// makes threads which only load frames run when nothing else wants the cpu
+// once enabled; every such thread calls backgroundThread when it starts
+void setIdleThreads(bool enabled);
+void backgroundThread();
+
+// what the governor looks at
+struct SystemLoad {
+    double load = 0; // one minute load average per core
+    double cpu = 0; // cpu time xanim took in percent of one core
+    bool battery = false; // running on a discharging battery
+    int charge = 100; // of the emptiest battery in percent
+};
+
+// lowers the rate frames are presented at while the machine runs on
+// battery, is busy with other work or xanim takes more than its share of
+// cpu time; the frames in between are held, so the video keeps its speed,
+// and the rate ramps back up once the conditions are gone
+class PowerGovernor {
+public:
+    // cpuBudget is the cpu time xanim may take in percent of one core, 0
+    // for no limit
+    PowerGovernor(FrameScheduler *scheduler, int cpuBudget);
+
+    // looks at the system again once GOVERNOR_INTERVAL passed; cheap
+    // enough for every frame
+    void update();
+
+    // share of the framerate frames are presented at
+    double factor() const { return current; }
+
+private:
+    void sample(SystemLoad*);
+    double target(const SystemLoad&) const;
+
+    FrameScheduler *scheduler;
+    int cpuBudget;
+    double current = 1, announced = 1;
+
+    std::chrono::steady_clock::time_point sampled;
+    std::chrono::steady_clock::duration cpuTime;
+};
+
+#endif
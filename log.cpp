@@ -0,0 +1,131 @@
+#include "log.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <stdint.h>
+#include <stdio.h>
+
+static LogLevel maxLevel = LogLevel::INFO;
+
+void setLogLevel(LogLevel level)
+{
+    maxLevel = level;
+}
+
+bool logEnabled(LogLevel level)
+{
+    return level <= maxLevel;
+}
+
+// writes records in the order they were made on a thread of its own; the
+// thread starts with the first record and drains the queue at exit
+class LogSink {
+public:
+    ~LogSink()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    void write(LogLevel level, std::string &&text)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!thread.joinable()) {
+            thread = std::thread(&LogSink::run, this);
+        }
+
+        records.push_back({ level, std::move(text) });
+        uint64_t record = ++queued;
+        wake.notify_all();
+
+        if (level == LogLevel::ERROR) {
+            written.wait(lock, [this, record] { return done >= record; });
+        }
+    }
+
+private:
+    struct Record {
+        LogLevel level;
+        std::string text;
+    };
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return stopping || !records.empty(); });
+            if (records.empty()) {
+                return;
+            }
+
+            // everything queued so far is written in one go without the lock
+            std::deque<Record> batch;
+            batch.swap(records);
+            lock.unlock();
+            for (const Record &record : batch) {
+                FILE *out = record.level <= LogLevel::WARNING ? stderr : stdout;
+                fwrite(record.text.data(), 1, record.text.size(), out);
+            }
+            fflush(stdout);
+            fflush(stderr);
+            lock.lock();
+
+            done += batch.size();
+            written.notify_all();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake, written;
+    std::deque<Record> records;
+    uint64_t queued = 0, done = 0;
+    bool stopping = false;
+    std::thread thread;
+};
+
+static LogSink &sink()
+{
+    static LogSink sink;
+    return sink;
+}
+
+LogRecord::LogRecord(LogRecord &&other)
+    : level(other.level), enabled(other.enabled), text(std::move(other.text))
+{
+    other.enabled = false;
+}
+
+LogRecord::~LogRecord()
+{
+    if (enabled) {
+        sink().write(level, text.str());
+    }
+}
+
+Progress::Progress(const std::string &task, size_t total)
+    : task(task), total(total)
+{
+}
+
+void Progress::update(size_t done)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    int pct = total > 0 ? std::min<size_t>(done * 100 / total, 100) : 100;
+    if (pct == reported || (now < next && done < total)) {
+        return;
+    }
+
+    logInfo() << task << "... " << pct << "%\n";
+    reported = pct;
+    next = now + std::chrono::milliseconds(PROGRESS_INTERVAL);
+}
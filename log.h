@@ -0,0 +1,68 @@
+#ifndef LOG_H_INCLUDED
+#define LOG_H_INCLUDED
+
+#include <chrono>
+#include <sstream>
+#include <string>
+
+// shortest time between two progress reports in ms
+const int PROGRESS_INTERVAL = 250;
+
+enum class LogLevel {
+    ERROR, // something failed, usually right before exiting
+    WARNING, // something did not work, but playback goes on
+    INFO, // what xanim decided and how long things took
+    DEBUG // every single frame while loading
+};
+
+// records above this level are dropped; INFO by default
+void setLogLevel(LogLevel);
+bool logEnabled(LogLevel);
+
+// collects one record and hands it to the sink thread when it goes out of
+// scope, so callers never wait for the terminal or the journal; errors are
+// written before the record returns, as the program usually exits next
+class LogRecord {
+public:
+    explicit LogRecord(LogLevel level) : level(level), enabled(logEnabled(level)) {}
+    LogRecord(LogRecord &&other);
+    ~LogRecord();
+
+    template<typename T>
+    LogRecord &operator<<(const T &value)
+    {
+        if (enabled) {
+            text << value;
+        }
+        return *this;
+    }
+
+private:
+    LogLevel level;
+    bool enabled;
+    std::ostringstream text;
+};
+
+// errors and warnings go to stderr, the rest to stdout
+inline LogRecord logError() { return LogRecord(LogLevel::ERROR); }
+inline LogRecord logWarning() { return LogRecord(LogLevel::WARNING); }
+inline LogRecord logInfo() { return LogRecord(LogLevel::INFO); }
+inline LogRecord logDebug() { return LogRecord(LogLevel::DEBUG); }
+
+// reports how far a task with many steps got as "TASK... N%", at most every
+// PROGRESS_INTERVAL ms and once it is done, instead of a line per step
+class Progress {
+public:
+    Progress(const std::string &task, size_t total);
+
+    // done of the total steps are finished
+    void update(size_t done);
+
+private:
+    std::string task;
+    size_t total;
+    int reported = -1; // percentage
+    std::chrono::steady_clock::time_point next;
+};
+
+#endif
@@ -1,16 +1,19 @@
-// root window
-#include <X11/Xlib.h>
+#include "xanim.h"
+#include "video.h"
+#include "cache.h"
+#include "budget.h"
+#include "scheduler.h"
+#include "screen.h"
+#include "stats.h"
+#include "backend.h"
+#include "playlist.h"
+#include "control.h"
+#include "governor.h"
+#include "log.h"
 
-// rendering
-#include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 
-// video fram extraction
-#include <opencv2/core.hpp>
-#include <opencv2/videoio.hpp>
-
-#include <vector>
-#include <string>
+#include <algorithm>
 #include <iostream>
 #include <stdio.h>
 
@@ -21,93 +24,125 @@ const char *VERSION = "xanim version 1.1 (2021-01-13)";
 const char *AUTHOR = "Bastian Engel <bastian.engel00@gmail.com>";
 const char *PROGRAM_LOCATION;
 
-struct RenderContext {
-    Display*        dpy; // X11 display
-    Window          rootw; // X11 root window
-    SDL_Window*     sdlw; // SDL window
-    SDL_Renderer*   sdlr; // SDL renderer
-    int sdlwWidth, sdlwHeight; // SDL window dimensions
-
-    std::vector<SDL_Rect> monitors;
-};
-
-struct Video {
-    std::vector<SDL_Texture*> sdlTextures; // SDL Textures
-    int framerate; // Framerate in seconds
-};
-
-enum class DrawType {
-    MONITOR, // video is played given monitor
-    AREA, // video is played on given area
-    STRETCH, // video is played over all monitors
-    EACH // video is played on each monitor
-};
-
-struct Options {
-    DrawType drawType = DrawType::MONITOR;
-    int monitorIndex = 0;
-    SDL_Rect targetArea;
-    std::string videoFile;
-};
+// longest time in ms without checking for events
+const int MAX_WAIT = 100;
 
 Options parseOptions(int argc, char **argv);
-RenderContext setup();
-Video loadVideo(const RenderContext&, const std::string&);
+RenderContext setup(const Options&);
+void checkMonitor(const RenderContext&, const Options&);
+bool sleepWhileHidden(const RenderContext&, const Options&, ScreenWatcher*, Video*, Playlist*, Controller*,
+                      PlaybackStats*);
+bool buildCache(const Options&);
 void cleanup(RenderContext*);
 void printHelp();
 
 int main(int argc, char **argv)
 {
     Options options = parseOptions(argc, argv);
-    RenderContext rc = setup();
-    Video video = loadVideo(rc, options.videoFile);
 
-    if (options.drawType == DrawType::MONITOR && !(options.monitorIndex >= 0 && options.monitorIndex < rc.monitors.size())) {
-        std::cerr << "monitor index not in range. max allowed: " << rc.monitors.size() - 1 << "\n";
-        std::exit(EXIT_FAILURE);
+    if (options.buildCache) {
+        return buildCache(options) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::chrono::steady_clock::time_point wokeAt = std::chrono::steady_clock::now();
+    const char *wokeBy = "starting";
+    bool waking = true;
+
+    RenderContext rc = setup(options);
+    checkMonitor(rc, options);
+
+    // entries which can not be played are dropped; only a playlist without
+    // any playable video ends here
+    Video video = loadVideo(rc, options);
+    while (!video.frames) {
+        logWarning() << "skipping " << options.videoFile << ", which can not be played\n";
+        options.playlist.erase(options.playlist.begin());
+        if (options.playlist.empty()) {
+            logError() << "no video can be played\n";
+            std::exit(EXIT_FAILURE);
+        }
+        options.videoFile = options.playlist[0].file;
+        video = loadVideo(rc, options);
     }
 
-    int delay = 1000 / video.framerate;
+    FrameScheduler scheduler(video.framerate, rc.refreshRate);
+    ScreenWatcher screen(rc.dpy);
+    PlaybackStats stats(&scheduler, &video, options.statsFile, options.statsInterval);
+    Playlist playlist(rc, &options, &video, &scheduler);
+    Controller controller(rc, &options, &playlist, &scheduler, &stats);
+    PowerGovernor governor(&scheduler, options.cpuBudget);
+    if (!options.controlPath.empty()) {
+        controller.listen(options.controlPath);
+    }
 
     for (bool running = true; running;) {
-        // actual rendering
-        for (size_t img = 0; img < video.sdlTextures.size(); img++) {
-            SDL_RenderClear(rc.sdlr);
-            switch (options.drawType) {
-                case DrawType::MONITOR:
-                    SDL_RenderCopy(rc.sdlr, video.sdlTextures[img], NULL, &rc.monitors[options.monitorIndex]);
-                    break;
-
-                case DrawType::AREA:
-                    SDL_RenderCopy(rc.sdlr, video.sdlTextures[img], NULL, &options.targetArea);
-                    break;
-
-                case DrawType::STRETCH:
-                    SDL_RenderCopy(rc.sdlr, video.sdlTextures[img], NULL, NULL);
-                    break;
-
-                case DrawType::EACH:
-                    for (const SDL_Rect &rect : rc.monitors) {
-                        SDL_RenderCopy(rc.sdlr, video.sdlTextures[img], NULL, &rect);
-                    }
+        // nothing is drawn while nobody can see it
+        if (!screen.visible()) {
+            running = sleepWhileHidden(rc, options, &screen, &video, &playlist, &controller, &stats);
+            wokeAt = std::chrono::steady_clock::now();
+            wokeBy = "waking up";
+            waking = true;
+            continue;
+        }
 
+        // commands change what is drawn before the next frame
+        running = controller.update();
+        if (controller.paused()) {
+            controller.wait(MAX_WAIT);
+            stats.update();
+
+            SDL_Event event;
+            while (SDL_PollEvent(&event)) {
+                if (event.type == SDL_QUIT) {
+                    running = false;
+                }
             }
-            SDL_RenderPresent(rc.sdlr);
+            continue;
+        }
 
-            SDL_Delay(delay);
+        // the rest of the video and then the next one of the playlist load
+        // in the time until the next frame is due
+        std::chrono::steady_clock::time_point until = std::min(scheduler.nextDue(),
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(MAX_WAIT));
+        video.frames->load(until);
+        playlist.load(until);
+
+        // actual rendering; a held frame is still on screen and needs no
+        // present
+        bool due = scheduler.wait(MAX_WAIT);
+        if (due) {
+            stats.addWakeup(scheduler.wakeupDelay());
+            playlist.update();
+        }
+        if (due && scheduler.advance(video.frames)) {
+            std::chrono::steady_clock::time_point drawn = std::chrono::steady_clock::now();
+            playlist.present();
+            stats.addPresent(std::chrono::steady_clock::now() - drawn);
+
+            if (waking) {
+                std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - wokeAt;
+                logInfo() << "first frame after " << wokeBy << " took " << latency.count() << " ms\n";
+                waking = false;
+            }
+        }
+        stats.update();
+        if (options.governor) {
+            governor.update();
+        }
 
-            // only need to check for quit event as rendering is done permanently
-            // (hopefully this doesn't blow the CPU!)
-            SDL_Event event;
-            SDL_PollEvent(&event);
+        // frames can stay for seconds, so the quit event is checked at
+        // least every MAX_WAIT ms
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 running = false;
-                break;
             }
         }
     }
 
     // cleanup
+    playlist.release();
+    freeVideo(&video);
     cleanup(&rc);
 
     return EXIT_SUCCESS;
@@ -119,7 +154,7 @@ Options parseOptions(int argc, char **argv)
 
     PROGRAM_LOCATION = argv[0];
 
-    option options[8];
+    option options[32];
     // help
     options[0].long_name = "help";
     options[0].short_name = 'h';
@@ -151,8 +186,114 @@ Options parseOptions(int argc, char **argv)
     options[6].short_name = 'f';
     options[6].flags = GOPT_ARGUMENT_REQUIRED;
 
+    // stream with optional window size
+    options[7].long_name = "stream";
+    options[7].short_name = 0;
+    options[7].flags = GOPT_ARGUMENT_OPTIONAL;
+
+    // frame cache
+    options[8].long_name = "cache";
+    options[8].short_name = 0;
+    options[8].flags = GOPT_ARGUMENT_FORBIDDEN;
+    options[9].long_name = "cache-dir";
+    options[9].short_name = 0;
+    options[9].flags = GOPT_ARGUMENT_REQUIRED;
+    options[10].long_name = "build-cache";
+    options[10].short_name = 0;
+    options[10].flags = GOPT_ARGUMENT_FORBIDDEN;
+
+    // parallel decoding
+    options[11].long_name = "jobs";
+    options[11].short_name = 'j';
+    options[11].flags = GOPT_ARGUMENT_REQUIRED;
+
+    // prescale
+    options[12].long_name = "prescale";
+    options[12].short_name = 'p';
+    options[12].flags = GOPT_ARGUMENT_FORBIDDEN;
+
+    // delta frames with optional threshold
+    options[13].long_name = "delta";
+    options[13].short_name = 0;
+    options[13].flags = GOPT_ARGUMENT_OPTIONAL;
+
+    // merge similar frames with optional threshold
+    options[14].long_name = "merge";
+    options[14].short_name = 0;
+    options[14].flags = GOPT_ARGUMENT_OPTIONAL;
+
+    // release frames while the screen is hidden
+    options[15].long_name = "idle-release";
+    options[15].short_name = 0;
+    options[15].flags = GOPT_ARGUMENT_REQUIRED;
+
+    // memory budget
+    options[16].long_name = "max-memory";
+    options[16].short_name = 0;
+    options[16].flags = GOPT_ARGUMENT_REQUIRED;
+
+    // pixel format of stored frames
+    options[17].long_name = "format";
+    options[17].short_name = 0;
+    options[17].flags = GOPT_ARGUMENT_REQUIRED;
+
+    // compressed frames
+    options[18].long_name = "compress";
+    options[18].short_name = 0;
+    options[18].flags = GOPT_ARGUMENT_FORBIDDEN;
+
+    // playback statistics
+    options[19].long_name = "stats-file";
+    options[19].short_name = 0;
+    options[19].flags = GOPT_ARGUMENT_REQUIRED;
+    options[20].long_name = "stats-interval";
+    options[20].short_name = 0;
+    options[20].flags = GOPT_ARGUMENT_REQUIRED;
+
+    // render backend
+    options[21].long_name = "backend";
+    options[21].short_name = 0;
+    options[21].flags = GOPT_ARGUMENT_REQUIRED;
+
+    // playlist
+    options[22].long_name = "playlist";
+    options[22].short_name = 0;
+    options[22].flags = GOPT_ARGUMENT_REQUIRED;
+    options[23].long_name = "duration";
+    options[23].short_name = 'd';
+    options[23].flags = GOPT_ARGUMENT_REQUIRED;
+    options[24].long_name = "crossfade";
+    options[24].short_name = 0;
+    options[24].flags = GOPT_ARGUMENT_OPTIONAL;
+
+    // control socket with optional path
+    options[25].long_name = "control";
+    options[25].short_name = 0;
+    options[25].flags = GOPT_ARGUMENT_OPTIONAL;
+
+    // power governor with optional cpu budget
+    options[26].long_name = "governor";
+    options[26].short_name = 0;
+    options[26].flags = GOPT_ARGUMENT_OPTIONAL;
+    options[27].long_name = "idle-threads";
+    options[27].short_name = 0;
+    options[27].flags = GOPT_ARGUMENT_FORBIDDEN;
+
+    // resample to a lower framerate
+    options[28].long_name = "fps";
+    options[28].short_name = 0;
+    options[28].flags = GOPT_ARGUMENT_REQUIRED;
+
+    // log level
+    options[29].long_name = "quiet";
+    options[29].short_name = 'q';
+    options[29].flags = GOPT_ARGUMENT_FORBIDDEN;
+    options[30].long_name = "verbose";
+    options[30].short_name = 0;
+    options[30].flags = GOPT_ARGUMENT_FORBIDDEN;
+
     // gopt needs a GOPT_LAST option
-    options[7].flags = GOPT_LAST;
+    options[31].flags = GOPT_LAST;
 
     argc = gopt(argv, options);
     gopt_errors(argv[0], options);
@@ -169,182 +310,392 @@ Options parseOptions(int argc, char **argv)
         std::exit(EXIT_SUCCESS);
     }
 
+    // log level, set before anything is logged
+    if (options[29].count) {
+        setLogLevel(LogLevel::WARNING);
+    } else if (options[30].count) {
+        setLogLevel(LogLevel::DEBUG);
+    }
+
     // monitor
     if (options[2].count) {
         ops.monitorIndex = atoi(options[2].argument);
-        std::cout << "drawing on monitor of index " << ops.monitorIndex << "\n";
+        logInfo() << "drawing on monitor of index " << ops.monitorIndex << "\n";
     // area
     } else if (options[3].count) {
         ops.drawType = DrawType::AREA;
-        sscanf(options[2].argument, "%ix%i+%i+%i", &ops.targetArea.w, &ops.targetArea.h, &ops.targetArea.x, &ops.targetArea.y);
-        printf("widthxheight+x+y %ix%i+%i+%i\n",ops.targetArea.w, ops.targetArea.h, ops.targetArea.x, ops.targetArea.y);
-        std::cout << "drawing on area\n";
+        sscanf(options[3].argument, "%ix%i+%i+%i", &ops.targetArea.w, &ops.targetArea.h, &ops.targetArea.x, &ops.targetArea.y);
+        logInfo() << "widthxheight+x+y " << ops.targetArea.w << "x" << ops.targetArea.h << "+" << ops.targetArea.x << "+"
+            << ops.targetArea.y << "\n";
+        logInfo() << "drawing on area\n";
     // stretch
     } else if (options[4].count) {
         ops.drawType = DrawType::STRETCH;
-        std::cout << "drawing stretched over all monitors\n";
+        logInfo() << "drawing stretched over all monitors\n";
     // each
     } else if (options[5].count) {
         ops.drawType = DrawType::EACH;
-        std::cout << "drawing on each monitor\n";
+        logInfo() << "drawing on each monitor\n";
+    }
+
+    // how long each video of a playlist plays
+    PlaylistEntry defaults;
+    if (options[23].count && !parseEntryLength(options[23].argument, &defaults)) {
+        logError() << "invalid duration " << options[23].argument << "; use e.g. 30s, 5m or 3x\n";
+        std::exit(EXIT_FAILURE);
     }
 
-    // video file
+    // video files, which are played in turn if there are several
     if (options[6].count) {
-        ops.videoFile = options[6].argument;
-    } else if (argc > 1) {
-        ops.videoFile = argv[1];
-    } else {
-        std::cerr << "no video file specified\n";
+        defaults.file = options[6].argument;
+        ops.playlist.push_back(defaults);
+    }
+    for (int i = 1; i < argc; i++) {
+        defaults.file = argv[i];
+        ops.playlist.push_back(defaults);
+    }
+    if (options[22].count && !readPlaylist(options[22].argument, defaults, &ops.playlist)) {
+        logError() << "failed to read playlist " << options[22].argument << "\n";
         std::exit(EXIT_FAILURE);
     }
+    if (ops.playlist.empty()) {
+        logError() << "no video file specified\n";
+        std::exit(EXIT_FAILURE);
+    }
+    ops.videoFile = ops.playlist[0].file;
+    if (ops.playlist.size() > 1) {
+        logInfo() << "playing a playlist of " << ops.playlist.size() << " videos\n";
+    }
+
+    // crossfade between the videos of a playlist
+    if (options[24].count) {
+        ops.crossfade = options[24].argument ? atoi(options[24].argument) : 1000;
+        if (ops.crossfade < 0) {
+            logError() << "crossfade must not be negative\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // stream
+    if (options[7].count) {
+        ops.stream = true;
+        if (options[7].argument) {
+            int frames = atoi(options[7].argument);
+            if (frames < 2) {
+                logError() << "stream window needs at least 2 frames\n";
+                std::exit(EXIT_FAILURE);
+            }
+            ops.streamFrames = frames;
+        }
+    }
+
+    // frame cache
+    ops.cache = options[8].count || options[9].count || options[10].count;
+    ops.buildCache = options[10].count;
+    ops.cacheDir = options[9].count ? options[9].argument : defaultCacheDir();
+
+    // parallel decoding
+    if (options[11].count) {
+        ops.jobs = atoi(options[11].argument);
+        if (ops.jobs < 0) {
+            logError() << "number of jobs must not be negative\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // prescale
+    ops.prescale = options[12].count;
+
+    // delta frames
+    if (options[13].count) {
+        ops.delta = true;
+        if (options[13].argument) {
+            ops.deltaThreshold = atoi(options[13].argument);
+        }
+        if (ops.stream) {
+            logInfo() << "delta frames are not used while streaming\n";
+        }
+    }
+
+    // merge similar frames
+    if (options[14].count) {
+        ops.mergeThreshold = options[14].argument ? atoi(options[14].argument) : 2;
+        if (ops.mergeThreshold < 0) {
+            logError() << "merge threshold must not be negative\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // release frames while the screen is hidden
+    if (options[15].count) {
+        ops.idleRelease = atoi(options[15].argument);
+        if (ops.idleRelease < 0) {
+            logError() << "idle time must not be negative\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // memory budget
+    if (options[16].count && !parseSize(options[16].argument, &ops.maxMemory)) {
+        logError() << "invalid memory budget " << options[16].argument << "; use e.g. 512M or 2G\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // pixel format of stored frames
+    if (options[17].count && !parseFormat(options[17].argument, &ops.pixelFormat)) {
+        logError() << "unknown pixel format " << options[17].argument << "; use rgb24, iyuv, nv12 or rgb565\n";
+        std::exit(EXIT_FAILURE);
+    }
+    // compressed frames
+    if (options[18].count) {
+        ops.compress = true;
+        if (ops.stream) {
+            logInfo() << "frames are not compressed while streaming\n";
+        }
+        if (ops.delta) {
+            logInfo() << "compressed frames already only grow with the changes; not using delta frames\n";
+            ops.delta = false;
+        }
+    }
+
+    // playback statistics
+    if (options[19].count) {
+        ops.statsFile = options[19].argument;
+    }
+    if (options[20].count) {
+        ops.statsInterval = atoi(options[20].argument);
+        if (ops.statsInterval < 1) {
+            logError() << "stats interval must be at least 1 second\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // render backend
+    if (options[21].count) {
+        std::string backend = options[21].argument;
+        if (backend == "auto") {
+            ops.backend = Backend::AUTO;
+        } else if (backend == "sdl") {
+            ops.backend = Backend::SDL;
+        } else if (backend == "xshm") {
+            ops.backend = Backend::XSHM;
+        } else {
+            logError() << "unknown backend " << backend << "; use auto, sdl or xshm\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // control socket
+    if (options[25].count) {
+        ops.controlPath = options[25].argument ? options[25].argument : defaultControlPath();
+    }
+
+    // power governor
+    if (options[26].count) {
+        ops.governor = true;
+        if (options[26].argument) {
+            ops.cpuBudget = atoi(options[26].argument);
+            if (ops.cpuBudget < 1) {
+                logError() << "cpu budget must be at least 1 percent\n";
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+    ops.idleThreads = options[27].count;
+    setIdleThreads(ops.idleThreads);
+
+    // resample to a lower framerate
+    if (options[28].count) {
+        ops.fps = atof(options[28].argument);
+        if (!(ops.fps > 0)) {
+            logError() << "fps must be greater than 0\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    if (ops.delta && ops.pixelFormat != PixelFormat::RGB24) {
+        logInfo() << "delta frames are always stored as rgb24\n";
+        ops.pixelFormat = PixelFormat::RGB24;
+    }
 
     return ops;
 }
 
-RenderContext setup()
+RenderContext setup(const Options &options)
 {
     RenderContext rc;
 
     // get root window
     rc.dpy = XOpenDisplay(NULL);
     if (rc.dpy == NULL) {
-        std::cerr << "failed to open X11 display\n";
+        logError() << "failed to open X11 display\n";
         std::exit(EXIT_FAILURE);
     }
     rc.rootw = DefaultRootWindow(rc.dpy);
-    std::cout << "root window grabbed\n";
+    logInfo() << "root window grabbed\n";
 
     // create SDL renderer
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
-        std::cerr << "failed to initialize SDL with SDL_INIT_VIDEO: " << SDL_GetError() << "\n";
+        logError() << "failed to initialize SDL with SDL_INIT_VIDEO: " << SDL_GetError() << "\n";
         std::exit(EXIT_FAILURE);
     }
 
     if ((rc.sdlw = SDL_CreateWindowFrom((void*)rc.rootw)) == NULL) {
-        std::cerr << "failed to create SDL window from root window: " << SDL_GetError() << "\n";
+        logError() << "failed to create SDL window from root window: " << SDL_GetError() << "\n";
         std::exit(EXIT_FAILURE);
     }
 
-    if ((rc.sdlr = SDL_CreateRenderer(rc.sdlw, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC)) == NULL) {
-        std::cerr << "failed to create SDL renderer from SDL window: " << SDL_GetError() << "\n";
+    rc.sdlr = NULL;
+    if (options.backend != Backend::XSHM
+        && (rc.sdlr = SDL_CreateRenderer(rc.sdlw, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC)) == NULL) {
+        logError() << "failed to create SDL renderer from SDL window: " << SDL_GetError() << "\n";
         std::exit(EXIT_FAILURE);
     }
 
     // width and height of X11 root
     SDL_GetWindowSize(rc.sdlw, &rc.sdlwWidth, &rc.sdlwHeight);
-    std::cout << "SDL window and renderer successfully initialized; got dimensions of "
+    logInfo() << "SDL window and renderer successfully initialized; got dimensions of "
         << rc.sdlwWidth << "x" << rc.sdlwHeight << "\n";
 
+    // SDL's software renderer scales and copies every frame twice, which
+    // MIT-SHM saves
+    SDL_RendererInfo info;
+    bool software = rc.sdlr && SDL_GetRendererInfo(rc.sdlr, &info) == 0 && (info.flags & SDL_RENDERER_SOFTWARE);
+    if (options.backend == Backend::XSHM || (options.backend == Backend::AUTO && software)) {
+        rc.backend = ShmBackend::create(rc.dpy, rc.rootw, rc.sdlwWidth, rc.sdlwHeight);
+        if (rc.backend) {
+            SDL_DestroyRenderer(rc.sdlr);
+            rc.sdlr = NULL;
+        } else if (!rc.sdlr) {
+            logError() << "failed to set up the xshm backend\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    if (!rc.backend) {
+        rc.backend = new SdlBackend;
+    }
+    if (rc.sdlr && SDL_GetRendererInfo(rc.sdlr, &info) == 0) {
+        rc.textureFormats.assign(info.texture_formats, info.texture_formats + info.num_texture_formats);
+    }
+    logInfo() << "rendering with the " << rc.backend->name() << " backend\n";
+
     // width and height of each individual monitor
     for (int i = 0; i < SDL_GetNumVideoDisplays(); i++) {
         SDL_Rect rect;
         SDL_GetDisplayBounds(i, &rect);
         rc.monitors.emplace_back(rect);
-        printf("monitor %i dimensions: %ix%i+%i+%i\n", i, rect.w, rect.h, rect.x, rect.y);
+        logInfo() << "monitor " << i << " dimensions: " << rect.w << "x" << rect.h << "+" << rect.x << "+" << rect.y << "\n";
+    }
+
+    // presents only wait for the vertical blank if vsync was granted
+    rc.refreshRate = 0;
+    SDL_DisplayMode mode;
+    if (rc.sdlr && SDL_GetRendererInfo(rc.sdlr, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC)
+        && SDL_GetCurrentDisplayMode(std::max(0, SDL_GetWindowDisplayIndex(rc.sdlw)), &mode) == 0) {
+        rc.refreshRate = mode.refresh_rate;
+        logInfo() << "presenting in sync with a refresh rate of " << rc.refreshRate << " Hz\n";
     }
 
     int img_flags = IMG_INIT_PNG;
     if (!(IMG_Init(img_flags) & img_flags)) {
-        std::cerr << "failed to initialize SDL_image: " << IMG_GetError() << "\n";
+        logError() << "failed to initialize SDL_image: " << IMG_GetError() << "\n";
         std::exit(EXIT_FAILURE);
     }
 
     return rc;
 }
 
-Video loadVideo(const RenderContext &rc, const std::string &file)
+bool sleepWhileHidden(const RenderContext &rc, const Options &options, ScreenWatcher *screen, Video *video,
+                      Playlist *playlist, Controller *controller, PlaybackStats *stats)
 {
-    Video video;
-
-    // open video
-    cv::VideoCapture vc(file);
-    if (!vc.isOpened()) {
-        std::cerr << "failed to open video file " << file << "; make sure it exists and is valid\n";
-        std::exit(EXIT_FAILURE);
-    }
+    logInfo() << "screen is hidden, pausing playback\n";
+    std::chrono::steady_clock::time_point releaseAt =
+        std::chrono::steady_clock::now() + std::chrono::seconds(options.idleRelease);
+
+    // no timers run while hidden, except for the one releasing the frames
+    for (;;) {
+        int timeout = -1;
+        if (video->frames && options.idleRelease >= 0) {
+            std::chrono::milliseconds left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                releaseAt - std::chrono::steady_clock::now());
+            timeout = std::max(0, (int)left.count());
+        }
 
-    std::cout << "loading video file " << file << "...\n";
+        bool visible = screen->wait(timeout, controller->fd());
+        stats->update();
+        if (!controller->update()) {
+            return false;
+        }
 
-    // get some properties
-    cv::Mat firstFrame;
-    vc >> firstFrame;
-    int channels = firstFrame.channels();
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT) {
+                return false;
+            }
+        }
 
-    vc.set(cv::CAP_PROP_POS_FRAMES, 0);
+        if (visible) {
+            break;
+        }
 
-    unsigned int width = vc.get(cv::CAP_PROP_FRAME_WIDTH);
-    unsigned int height = vc.get(cv::CAP_PROP_FRAME_HEIGHT);
-    std::cout << "image dimensions " << width << "x" << height << ", channels " << channels << "\n";
-    if (width != rc.sdlwWidth || height != rc.sdlwHeight) {
-        std::cout << "image dimensions and window dimensions differ; frames will be rendered accordingly\n";
+        if (video->frames && options.idleRelease >= 0 && std::chrono::steady_clock::now() >= releaseAt) {
+            freeVideo(video);
+            playlist->release();
+            logInfo() << "released frames after " << options.idleRelease << " seconds of idling\n";
+        }
     }
-    video.framerate = vc.get(cv::CAP_PROP_FPS);
-
-    uint8_t *pixelData = new uint8_t[width * height * 3];
-    size_t frameCount = vc.get(cv::CAP_PROP_FRAME_COUNT);
 
-    // get textures
-    cv::Mat frame;
-    for (size_t frameIndex = 0; frameIndex < frameCount; frameIndex++) {
-        // get opencv frame
-        int pct = (frameIndex + 1) / (float)frameCount * 100;
-        std::cout << "parsing frame " << frameIndex << "... (" << pct << "%)\n";
-        vc >> frame;
-
-        // opencv mat format may differ, but we need a common pixel format to shove into
-        // SDL (we will use 8 bits per channel with 3 channels)
-        frame.convertTo(frame, CV_8U);
+    logInfo() << "screen is visible again, resuming playback\n";
+    if (!video->frames) {
+        *video = loadVideo(rc, playlist->options());
+    }
+    if (!video->frames) {
+        logError() << "the video can not be loaded again\n";
+        return false;
+    }
 
-        for (size_t x = 0; x < width; x++) {
-            for (size_t y = 0; y < height; y++) {
-                // opencv uses BGR, but we want RGB
-                uint8_t b = frame.at<uint8_t>(y, x * channels + 0);
-                uint8_t g = frame.at<uint8_t>(y, x * channels + 1);
-                uint8_t r = frame.at<uint8_t>(y, x * channels + 2);
-                pixelData[3 * (y * width + x) + 0] = r;
-                pixelData[3 * (y * width + x) + 1] = g;
-                pixelData[3 * (y * width + x) + 2] = b;
-            }
-        }
+    return true;
+}
 
-        // then, convert to SDL_Surface
-        SDL_Surface *surface = SDL_CreateRGBSurfaceFrom((void*)pixelData, width,
-                                                        height, 24, width * 3, 0x0000ff, 0x00ff00, 0xff0000, 0);
-
-        if (surface) {
-            // for some reason textures are stored in RAM instead of VRAM so large videos
-            // may cause problems, TODO fix or add warning
-            SDL_Texture *texture = SDL_CreateTextureFromSurface(rc.sdlr, surface);
-            if (texture) {
-                video.sdlTextures.push_back(texture);
-            } else {
-                std::cerr << "Texture of frame " << frameIndex << " could not be created\n";
-            }
-            SDL_FreeSurface(surface);
-        } else {
-            std::cerr << "Surface of frame " << frameIndex << " could not be created\n";
-        }
+void checkMonitor(const RenderContext &rc, const Options &options)
+{
+    if (options.drawType == DrawType::MONITOR && !(options.monitorIndex >= 0 && options.monitorIndex < rc.monitors.size())) {
+        logError() << "monitor index not in range. max allowed: " << rc.monitors.size() - 1 << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+}
 
-        SDL_Rect dstArea { 0, 0, 1920, 1080 };
-        SDL_RenderCopy(rc.sdlr, video.sdlTextures.back(), NULL, &dstArea);
-        SDL_RenderPresent(rc.sdlr);
+bool buildCache(const Options &options)
+{
+    // the size of a manual area is known without asking the X server
+    RenderContext rc;
+    bool display = options.drawType != DrawType::AREA;
+    if (display) {
+        rc = setup(options);
+        checkMonitor(rc, options);
     }
 
-    delete[] pixelData;
+    int targetWidth, targetHeight;
+    targetSize(rc, options, &targetWidth, &targetHeight);
 
-    if (video.sdlTextures.size() <= 0) {
-        std::cerr << "no textures were loaded\n";
-        std::exit(EXIT_FAILURE);
+    bool ok = false;
+    CacheKey key;
+    if (cacheKey(options.videoFile, targetWidth, targetHeight, options.pixelFormat, options.fps, &key)) {
+        ok = FrameCache::build(options.cacheDir, options.videoFile, key, options.jobs);
+    } else {
+        logError() << "failed to read video file " << options.videoFile << "\n";
     }
 
-    std::cout << video.sdlTextures.size() << " textures were created\n";
+    if (display) {
+        cleanup(&rc);
+    }
 
-    return video;
+    return ok;
 }
 
 void cleanup(RenderContext *rc)
 {
+    delete rc->backend;
     XCloseDisplay(rc->dpy);
 
     SDL_Quit();
@@ -356,7 +707,7 @@ void printHelp()
 {
     printf("\
         %s\n\
-        Usage: %s [OPTION]... [FILE]\n\
+        Usage: %s [OPTION]... [FILE]...\n\
 ABOUT\n\
         This program was written by %s\n\
         and is licensed under the GPLv2.0\n\
@@ -368,6 +719,30 @@ OPTIONS\n\
         -a, --area          specify area (wxh+x+y)\n\
         -s, --stretch       stretch over all monitors\n\
         -e, --each          draw on each monitor\n\
-        -f, --help          view this help message\n",
+        -f, --file          video file to play\n\
+            --stream[=N]    decode while playing, keeping N frames ahead (default 16)\n\
+            --cache         use preprocessed frames, creating them if needed\n\
+            --cache-dir DIR where cache files are kept (implies --cache)\n\
+            --build-cache   only create the cache file for FILE and exit\n\
+        -j, --jobs N        decoder threads while loading (default: one per core)\n\
+        -p, --prescale      scale frames to the size they are drawn at while loading\n\
+            --delta[=T]     only store the parts of frames which changed by more than T (default 4)\n\
+            --merge[=T]     show frames which differ by at most T on average as one (default 2)\n\
+            --idle-release S free the frames once the screen was hidden for S seconds\n\
+            --max-memory M  keep frames within M bytes (e.g. 512M, 2G), picking how they are stored\n\
+            --format F      store frames as rgb24 (default), iyuv, nv12 or rgb565\n\
+            --compress      keep frames compressed in RAM, decompressing them while playing\n\
+            --stats-file F  rewrite F with playback statistics as JSON (SIGUSR1 prints them)\n\
+            --stats-interval S seconds between rewrites of the stats file (default 10)\n\
+            --backend B     render with sdl, xshm or auto (default: xshm without a GPU)\n\
+            --playlist F    play the videos listed in F, one \"FILE [T]\" per line\n\
+        -d, --duration T    play each video of a playlist for T (30s, 5m) or T loops (3x; default 1x)\n\
+            --crossfade[=MS] blend videos of a playlist into each other over MS ms (default 1000)\n\
+            --control[=PATH] take commands on a unix socket (default $XDG_RUNTIME_DIR/xanim.sock)\n\
+            --governor[=P]  present fewer frames on battery, under load or above P%% of a core\n\
+            --idle-threads  decode and load only on otherwise idle cores\n\
+            --fps N         only keep the frames needed to play at N fps (fractions allowed)\n\
+        -q, --quiet         only print warnings and errors\n\
+            --verbose       also print every frame while loading\n",
            VERSION, PROGRAM_LOCATION, AUTHOR);
 }
@@ -0,0 +1,281 @@
+#include "playlist.h"
+#include "backend.h"
+#include "governor.h"
+#include "log.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include <stdlib.h>
+
+bool parseEntryLength(const char *text, PlaylistEntry *entry)
+{
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || value <= 0) {
+        return false;
+    }
+
+    std::string unit = end;
+    if (unit == "x") {
+        entry->seconds = 0;
+        entry->loops = value;
+    } else if (unit == "" || unit == "s") {
+        entry->seconds = value;
+    } else if (unit == "m") {
+        entry->seconds = value * 60;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool readPlaylist(const std::string &file, const PlaylistEntry &defaults, std::vector<PlaylistEntry> *entries)
+{
+    std::ifstream in(file);
+    if (!in) {
+        return false;
+    }
+
+    size_t slash = file.rfind('/');
+    std::string directory = slash == std::string::npos ? "" : file.substr(0, slash + 1);
+
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t begin = line.find_first_not_of(" \t");
+        size_t end = line.find_last_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#') {
+            continue;
+        }
+        line = line.substr(begin, end - begin + 1);
+
+        // the last word is the length if it parses as one, so file names may
+        // contain spaces
+        PlaylistEntry entry = defaults;
+        size_t space = line.find_last_of(" \t");
+        if (space != std::string::npos && parseEntryLength(line.c_str() + space + 1, &entry)) {
+            line = line.substr(0, line.find_last_not_of(" \t", space) + 1);
+        }
+
+        entry.file = line[0] == '/' ? line : directory + line;
+        entries->push_back(entry);
+    }
+
+    return true;
+}
+
+Playlist::Playlist(const RenderContext &rc, Options *options, Video *video, FrameScheduler *scheduler)
+    : rc(rc), base(options), video(video), scheduler(scheduler), fadeScheduler(video->framerate, rc.refreshRate)
+{
+    started = std::chrono::steady_clock::now();
+    startPeriods = scheduler->framePeriods();
+}
+
+Playlist::~Playlist()
+{
+    release();
+}
+
+void Playlist::load(std::chrono::steady_clock::time_point until)
+{
+    if (base->playlist.size() < 2 && !skipping) {
+        return;
+    }
+
+    if (!next.frames && !preparing.joinable()) {
+        prepare();
+        return;
+    }
+    if (!next.frames) {
+        if (!prepared) {
+            return;
+        }
+
+        // only the store is created here; its textures follow in load(),
+        // a few at a time
+        preparing.join();
+        if (!upcoming.failed) {
+            next = loadVideo(rc, &upcoming);
+        }
+        if (!next.frames) {
+            skipUpcoming();
+            return;
+        }
+    }
+
+    // the rest of the video loads once it is playing
+    if (!next.frames->ready() || next.frames->residentBytes() < prefetchBudget()) {
+        if (!next.frames->load(until) && !next.frames->ready()) {
+            logWarning() << "no textures were loaded\n";
+            freeVideo(&next);
+            skipUpcoming();
+        }
+    }
+}
+
+void Playlist::update()
+{
+    if (!skipping && (base->playlist.size() < 2 || !due())) {
+        return;
+    }
+
+    // the current video goes on until the first frame of the next one is
+    // there
+    if (!next.frames || !next.frames->ready()) {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    freeVideo(&fading);
+    if (base->crossfade > 0 && rc.backend->fades()) {
+        fading = *video;
+        fadeScheduler = FrameScheduler(fading.framerate, rc.refreshRate);
+        fadeStarted = now;
+    } else {
+        freeVideo(video);
+    }
+
+    *video = next;
+    next = Video();
+    scheduler->setFramerate(video->framerate);
+
+    if (!replacement.empty()) {
+        base->playlist = replacement;
+        replacement.clear();
+    }
+    current = upcomingIndex;
+    failures = 0;
+    skipping = false;
+    shown = nullptr;
+    started = now;
+    startPeriods = scheduler->framePeriods();
+    logInfo() << "playing " << base->playlist[current].file << "\n";
+}
+
+void Playlist::present()
+{
+    if (fading.frames) {
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - fadeStarted;
+        float amount = elapsed.count() / base->crossfade;
+        if (amount < 1) {
+            fadeScheduler.advance(fading.frames);
+            rc.backend->presentFade(rc, *base, fading.frames, video->frames, amount);
+            shown = video->frames;
+            return;
+        }
+
+        freeVideo(&fading);
+    }
+
+    rc.backend->present(rc, *base, video->frames);
+    shown = video->frames;
+}
+
+void Playlist::redraw()
+{
+    if (video->frames && shown == video->frames) {
+        rc.backend->present(rc, *base, video->frames);
+    }
+}
+
+void Playlist::play(const std::string &file)
+{
+    // whatever was prefetched belongs to the old playlist, which stays
+    // until the file is there
+    release();
+
+    PlaylistEntry entry;
+    entry.file = file;
+    replacement = { entry };
+    failures = 0;
+    skipping = true;
+}
+
+void Playlist::skip()
+{
+    skipping = true;
+}
+
+void Playlist::release()
+{
+    if (preparing.joinable()) {
+        preparing.join();
+    }
+    discardVideo(&upcoming);
+    freeVideo(&next);
+    freeVideo(&fading);
+    shown = nullptr;
+}
+
+Options Playlist::options() const
+{
+    Options options = *base;
+    if (!base->playlist.empty()) {
+        options.videoFile = base->playlist[current].file;
+    }
+
+    return options;
+}
+
+void Playlist::prepare()
+{
+    // every entry failed in a row, so the current video keeps playing
+    if (replacement.empty() && failures >= base->playlist.size()) {
+        return;
+    }
+
+    // opening and probing the video takes a while, but needs no renderer
+    Options options = *base;
+    if (replacement.empty()) {
+        upcomingIndex = (current + 1 + failures) % base->playlist.size();
+        options.videoFile = base->playlist[upcomingIndex].file;
+    } else {
+        upcomingIndex = 0;
+        options.videoFile = replacement[0].file;
+    }
+    prepared = false;
+    preparing = std::thread([this, options] {
+        backgroundThread();
+        upcoming = prepareVideo(rc, options);
+        prepared = true;
+    });
+}
+
+void Playlist::skipUpcoming()
+{
+    logWarning() << "skipping " << upcoming.options.videoFile << ", which can not be played\n";
+    discardVideo(&upcoming);
+
+    // a file which was asked for leaves the playlist as it was
+    if (!replacement.empty()) {
+        replacement.clear();
+        skipping = false;
+        return;
+    }
+
+    if (++failures >= base->playlist.size()) {
+        logWarning() << "no video of the playlist can be played; staying with the current one\n";
+        skipping = false;
+    }
+}
+
+bool Playlist::due() const
+{
+    const PlaylistEntry &entry = base->playlist[current];
+    if (entry.seconds > 0) {
+        return std::chrono::steady_clock::now() - started >= std::chrono::seconds(entry.seconds);
+    }
+
+    return scheduler->framePeriods() - startPeriods >= entry.loops * std::max<size_t>(1, video->frameCount);
+}
+
+size_t Playlist::prefetchBudget() const
+{
+    if (base->maxMemory == 0) {
+        return PREFETCH_BYTES;
+    }
+
+    size_t used = video->frames ? video->frames->residentBytes() : 0;
+    return std::min(PREFETCH_BYTES, base->maxMemory > used ? base->maxMemory - used : 0);
+}
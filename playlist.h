@@ -0,0 +1,92 @@
+#ifndef PLAYLIST_H_INCLUDED
+#define PLAYLIST_H_INCLUDED
+
+#include "video.h"
+#include "scheduler.h"
+
+#include <atomic>
+#include <thread>
+
+// memory the first frames of the next video may take while the current one
+// plays, unless the memory budget leaves less
+const size_t PREFETCH_BYTES = 256 * 1024 * 1024;
+
+// parses how long a video plays: seconds ("30", "30s"), minutes ("5m") or
+// loops ("3x"); returns false if it is malformed
+bool parseEntryLength(const char *text, PlaylistEntry*);
+// appends the entries of a playlist file, one "FILE [LENGTH]" per line;
+// entries without a length get the one of defaults, relative paths are
+// relative to the playlist; returns false if the file can not be read
+bool readPlaylist(const std::string &file, const PlaylistEntry &defaults, std::vector<PlaylistEntry> *entries);
+
+// plays the entries of a playlist in turn; while one plays, the next one is
+// prepared on a background thread and its first frames are uploaded in the
+// time the render loop has left, so the switch happens on a frame boundary
+// without waiting for anything
+class Playlist {
+public:
+    // video is the first entry, which the caller already loaded; without a
+    // second entry the video plays forever; options may change while
+    // playing
+    Playlist(const RenderContext&, Options *options, Video *video, FrameScheduler *scheduler);
+    ~Playlist();
+
+    // loads the next video until the given time
+    void load(std::chrono::steady_clock::time_point until);
+    // switches to the next video once the current one played long enough
+    // and the next one is ready; called when the next frame is due, before
+    // the scheduler advances
+    void update();
+    // presents the current frame, blended over the previous video while
+    // they crossfade
+    void present();
+    // presents the last frame again, e.g. after the areas changed; does
+    // nothing before the first present
+    void redraw();
+    // replaces the playlist with file, which plays as soon as its first
+    // frame is loaded
+    void play(const std::string &file);
+    // moves on to the next video as soon as its first frame is loaded
+    void skip();
+    // frees everything except the current video
+    void release();
+
+    // options of the entry which is playing
+    Options options() const;
+
+private:
+    void prepare();
+    // the entry being prepared can not be played, so the one after it is
+    // prepared next, until every entry failed in a row
+    void skipUpcoming();
+    bool due() const;
+    size_t prefetchBudget() const;
+
+    const RenderContext &rc;
+    Options *base;
+    Video *video;
+    FrameScheduler *scheduler;
+
+    size_t current = 0;
+    size_t upcomingIndex = 0; // entry which is prepared
+    size_t failures = 0; // entries after the current one which can not be played
+    // playlist which replaces the current one once its first video plays
+    std::vector<PlaylistEntry> replacement;
+    bool skipping = false; // switch without waiting for the current video
+    const FrameStore *shown = nullptr; // store of the last present
+    std::chrono::steady_clock::time_point started;
+    uint64_t startPeriods;
+
+    // the next entry is prepared on its own thread, then loaded here
+    std::thread preparing;
+    std::atomic<bool> prepared { false };
+    PreparedVideo upcoming;
+    Video next;
+
+    // previous video while it fades out
+    Video fading;
+    FrameScheduler fadeScheduler;
+    std::chrono::steady_clock::time_point fadeStarted;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "progressive.h"
+#include "cache.h"
+
+ProgressiveStore::ProgressiveStore(const RenderContext &rc, const Options &options, ParallelDecoder *decoder)
+    : decoder(decoder), builder(rc, &store, options.mergeThreshold, options.maxMemory),
+      progress("parsing frames", decoder->frameCount)
+{
+    store.format = decoder->format;
+    for (const cv::Size &size : decoder->sizes) {
+        store.variants.push_back({ size.width, size.height, {} });
+    }
+}
+
+ProgressiveStore::ProgressiveStore(const RenderContext &rc, const Options &options, FrameCache *cache)
+    : cache(cache), builder(rc, &store, options.mergeThreshold, options.maxMemory),
+      progress("uploading cached frames", cache->frameCount)
+{
+    store.format = cache->format;
+    store.variants.push_back({ cache->width, cache->height, {} });
+}
+
+ProgressiveStore::~ProgressiveStore()
+{
+    delete decoder;
+    delete cache;
+}
+
+bool ProgressiveStore::next()
+{
+    return ready() && store.next();
+}
+
+SDL_Texture *ProgressiveStore::texture(int width, int height)
+{
+    return store.texture(width, height);
+}
+
+int ProgressiveStore::duration()
+{
+    return store.duration();
+}
+
+size_t ProgressiveStore::residentBytes() const
+{
+    return store.residentBytes();
+}
+
+bool ProgressiveStore::load(std::chrono::steady_clock::time_point until)
+{
+    if (cache) {
+        return loadCached(until);
+    }
+    if (!decoder) {
+        return false;
+    }
+
+    // a frame being uploaded when the time is up makes the next frame late
+    // by as much, which is short compared to a frame period
+    while (std::chrono::steady_clock::now() < until) {
+        PixelBuffer *buffer = decoder->pop();
+        if (!buffer) {
+            if (decoder->done()) {
+                finish();
+                return false;
+            }
+            decoder->waitUntil(until);
+            continue;
+        }
+
+        add(buffer);
+
+        // the frame count was too low, so the rest is not worth decoding
+        if (builder.full()) {
+            logWarning() << "video does not fit into the memory budget and was cut\n";
+            finish();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ProgressiveStore::add(PixelBuffer *buffer)
+{
+    logDebug() << "parsing frame " << buffer->frame << "\n";
+
+    if (!builder.add(buffer->frame, buffer->pixels) && !builder.full()) {
+        logWarning() << "Texture of frame " << buffer->frame << " could not be created\n";
+    }
+    progress.update(builder.frameCount());
+    decoder->release(buffer);
+
+    // the loop of the loaded part grows as soon as the gap after it closes
+    builder.extend();
+}
+
+bool ProgressiveStore::loadCached(std::chrono::steady_clock::time_point until)
+{
+    // frames are uploaded straight from the mapping, and the kernel reads
+    // the next one while this one is uploaded
+    while (std::chrono::steady_clock::now() < until) {
+        if (cached == cache->frameCount) {
+            finish();
+            return false;
+        }
+        if (cached + 1 < cache->frameCount) {
+            cache->prefetch(cached + 1);
+        }
+
+        if (!builder.add(cached, { const_cast<uint8_t*>(cache->frame(cached)) })) {
+            if (builder.full()) {
+                logWarning() << "video does not fit into the memory budget and was cut\n";
+                finish();
+                return false;
+            }
+            logWarning() << "Texture of frame " << cached << " could not be created\n";
+        }
+        cached++;
+        progress.update(builder.frameCount());
+        builder.extend();
+    }
+
+    return true;
+}
+
+void ProgressiveStore::finish()
+{
+    size_t frameCount = builder.frameCount();
+    builder.finish();
+
+    // segments which were cut short are stopped
+    delete decoder;
+    decoder = nullptr;
+    delete cache;
+    cache = nullptr;
+
+    printTimeline(&store, frameCount);
+}
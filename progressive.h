@@ -0,0 +1,46 @@
+#ifndef PROGRESSIVE_H_INCLUDED
+#define PROGRESSIVE_H_INCLUDED
+
+#include "video.h"
+#include "decoder.h"
+#include "timeline.h"
+#include "log.h"
+
+class FrameCache;
+
+// starts playing a preloaded video as soon as its first frame is there;
+// the part loaded without a gap loops until the frames after it arrive,
+// while load() uploads whatever the decoder threads finished in the time
+// the render loop would otherwise sleep
+class ProgressiveStore : public FrameStore {
+public:
+    // takes ownership of the decoder; nothing is loaded before the first
+    // call to load()
+    ProgressiveStore(const RenderContext&, const Options&, ParallelDecoder *decoder);
+    // takes ownership of the cache, whose frames are uploaded in order
+    ProgressiveStore(const RenderContext&, const Options&, FrameCache *cache);
+    ~ProgressiveStore();
+
+    bool next() override;
+    SDL_Texture *texture(int width, int height) override;
+    int duration() override;
+    size_t residentBytes() const override;
+    bool load(std::chrono::steady_clock::time_point until) override;
+    // the first frame of the video was loaded
+    bool ready() const override { return !store.timeline.empty(); }
+    const SDL_Rect *region() const override { return store.region(); }
+
+private:
+    void add(PixelBuffer*);
+    bool loadCached(std::chrono::steady_clock::time_point until);
+    void finish();
+
+    TextureStore store;
+    ParallelDecoder *decoder = nullptr; // nullptr once everything is loaded
+    FrameCache *cache = nullptr; // as is the cache
+    size_t cached = 0; // frames of the cache which were added
+    TimelineBuilder builder;
+    Progress progress;
+};
+
+#endif
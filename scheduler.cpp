@@ -0,0 +1,101 @@
+#include "scheduler.h"
+#include "log.h"
+
+#include <algorithm>
+#include <thread>
+
+// videos which do not know their framerate are played at this one
+const double DEFAULT_FRAMERATE = 30.0;
+
+FrameScheduler::FrameScheduler(double framerate, int refreshRate)
+{
+    setFramerate(framerate);
+    slack = refreshRate > 0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(0.5 / refreshRate))
+        : Clock::duration::zero();
+    deadline = Clock::now();
+}
+
+void FrameScheduler::setFramerate(double framerate)
+{
+    if (!(framerate > 0)) {
+        logWarning() << "video has no valid framerate, playing at " << DEFAULT_FRAMERATE << " fps\n";
+        framerate = DEFAULT_FRAMERATE;
+    }
+
+    period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framerate));
+}
+
+void FrameScheduler::setMaxRate(double rate)
+{
+    minInterval = rate > 0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate))
+        : Clock::duration::zero();
+}
+
+void FrameScheduler::setThrottle(double factor)
+{
+    throttle = std::min(1.0, factor);
+}
+
+void FrameScheduler::restart()
+{
+    deadline = Clock::now();
+}
+
+FrameScheduler::Clock::time_point FrameScheduler::nextDue() const
+{
+    // advance skips the frames which were due before; without a throttle
+    // frames stay in step with the blanks
+    Clock::duration interval = minInterval;
+    if (throttle < 1) {
+        interval = std::max(interval, std::chrono::duration_cast<Clock::duration>(period / throttle));
+    }
+
+    return std::max(deadline - slack, lastDue + interval);
+}
+
+bool FrameScheduler::wait(int maxWait)
+{
+    Clock::time_point due = nextDue();
+    Clock::time_point limit = Clock::now() + std::chrono::milliseconds(maxWait);
+    if (due <= limit) {
+        std::this_thread::sleep_until(due);
+        delay = std::max(Clock::now() - due, Clock::duration::zero());
+        lastDue = due;
+        return true;
+    }
+
+    std::this_thread::sleep_until(limit);
+    return false;
+}
+
+bool FrameScheduler::advance(FrameStore *frames)
+{
+    Clock::time_point now = Clock::now();
+
+    // after a stall like a suspend, carry on from now instead of racing
+    // through everything that was missed
+    if (now - deadline > std::chrono::seconds(1)) {
+        deadline = now;
+    }
+
+    if (!frames->next()) {
+        // the frame is not ready, so the video slows down instead of
+        // skipping ahead once it is
+        deadline += period;
+        late++;
+        return false;
+    }
+    deadline += period * frames->duration();
+    periods += frames->duration();
+
+    // a frame whose successor is due before the next blank is never seen
+    while (deadline <= now + slack && frames->next()) {
+        deadline += period * frames->duration();
+        periods += frames->duration();
+        dropped++;
+    }
+
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef SCHEDULER_H_INCLUDED
+#define SCHEDULER_H_INCLUDED
+
+#include "video.h"
+
+#include <chrono>
+
+// paces playback against absolute deadlines on the monotonic clock, so
+// rounding and the time spent presenting never add up to drift
+class FrameScheduler {
+public:
+    // refreshRate is the display refresh rate in Hz, 0 if unknown
+    FrameScheduler(double framerate, int refreshRate);
+
+    // sleeps until the next frame is due, but at most maxWait ms; returns
+    // true if it is due
+    bool wait(int maxWait);
+    // moves the store to the frame which should be on screen now, skipping
+    // frames which are already late; returns false if the current frame is
+    // held, so there is nothing new to present
+    bool advance(FrameStore *frames);
+    // paces the following frames at a new framerate, e.g. of the next video
+    void setFramerate(double framerate);
+    // presents at most rate frames per second, skipping the frames in
+    // between, which count as dropped; 0 for no limit
+    void setMaxRate(double rate);
+    // presents at most factor times the framerate, between 0 and 1, in the
+    // same way
+    void setThrottle(double factor);
+    // carries on from now instead of catching up, e.g. after a pause
+    void restart();
+    // when wait would wake up for the next frame
+    std::chrono::steady_clock::time_point nextDue() const;
+
+    // frame periods the frames moved past took, skipped ones included
+    uint64_t framePeriods() const { return periods; }
+    size_t droppedFrames() const { return dropped; }
+    // frames which were not ready when due
+    size_t lateFrames() const { return late; }
+    // how much later than planned the last wait returning true woke up
+    std::chrono::steady_clock::duration wakeupDelay() const { return delay; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::duration period; // of a video frame
+    // presents wait for the vertical blank, so a frame is due once the
+    // blank nearest to its deadline is the next one
+    Clock::duration slack;
+    Clock::time_point deadline; // of the next frame
+    Clock::duration minInterval = Clock::duration::zero(); // between presents
+    double throttle = 1;
+    Clock::time_point lastDue; // when wait last returned true
+    size_t dropped = 0, late = 0;
+    uint64_t periods = 0;
+    Clock::duration delay = Clock::duration::zero();
+};
+
+#endif
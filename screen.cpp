@@ -0,0 +1,182 @@
+#include "screen.h"
+#include "log.h"
+
+#include <X11/extensions/dpms.h>
+#include <X11/extensions/scrnsaver.h>
+
+#ifdef XANIM_LOGIND
+#include <systemd/sd-bus.h>
+#endif
+
+#include <poll.h>
+#include <stdlib.h>
+
+// the DPMS state is asked for at most this often while playing, in ms
+const int DPMS_CHECK_INTERVAL = 1000;
+// DPMS has no events, so while only it hides the screen it is asked this
+// often, in ms
+const int DPMS_POLL_INTERVAL = 2000;
+
+#ifdef XANIM_LOGIND
+const char *LOGIND_SERVICE = "org.freedesktop.login1";
+const char *LOGIND_SESSION = "org.freedesktop.login1.Session";
+#endif
+
+ScreenWatcher::ScreenWatcher(Display *dpy)
+    : dpy(dpy)
+{
+    Window root = DefaultRootWindow(dpy);
+
+    // the screen saver tells us when it starts and stops
+    int eventBase, errorBase;
+    if (XScreenSaverQueryExtension(dpy, &eventBase, &errorBase)) {
+        saverEvent = eventBase;
+        XScreenSaverSelectInput(dpy, root, ScreenSaverNotifyMask);
+
+        XScreenSaverInfo *info = XScreenSaverAllocInfo();
+        if (info && XScreenSaverQueryInfo(dpy, root, info)) {
+            saverOn = info->state == ScreenSaverOn;
+        }
+        XFree(info);
+    } else {
+        logWarning() << "MIT-SCREEN-SAVER is not available; playing while the screen saver runs\n";
+    }
+
+    int dummy;
+    hasDpms = DPMSQueryExtension(dpy, &dummy, &dummy) && DPMSCapable(dpy);
+    updateDpms(true);
+
+#ifdef XANIM_LOGIND
+    // logind only knows the session by its id, and signals use that path
+    sd_bus_error error = SD_BUS_ERROR_NULL;
+    char *id = nullptr, *path = nullptr;
+    if (sd_bus_open_system(&bus) >= 0
+        && sd_bus_get_property_string(bus, LOGIND_SERVICE, "/org/freedesktop/login1/session/auto",
+                                      LOGIND_SESSION, "Id", &error, &id) >= 0
+        && sd_bus_path_encode("/org/freedesktop/login1/session", id, &path) >= 0
+        && sd_bus_match_signal(bus, NULL, LOGIND_SERVICE, path, "org.freedesktop.DBus.Properties",
+                               "PropertiesChanged", NULL, NULL) >= 0) {
+        sessionPath = path;
+        updateLocked(true);
+    } else {
+        logWarning() << "not watching the session lock state: "
+            << (error.message ? error.message : "no logind session") << "\n";
+        bus = sd_bus_flush_close_unref(bus);
+    }
+    free(id);
+    free(path);
+    sd_bus_error_free(&error);
+#endif
+}
+
+ScreenWatcher::~ScreenWatcher()
+{
+    if (saverEvent >= 0) {
+        XScreenSaverSelectInput(dpy, DefaultRootWindow(dpy), 0);
+    }
+
+#ifdef XANIM_LOGIND
+    sd_bus_flush_close_unref(bus);
+#endif
+}
+
+bool ScreenWatcher::visible()
+{
+    updateSaver();
+    updateDpms(false);
+    if (bus) {
+        updateLocked(false);
+    }
+
+    return !saverOn && !dpmsOff && !locked;
+}
+
+bool ScreenWatcher::wait(int timeout, int wakeFd)
+{
+    if (visible()) {
+        return true;
+    }
+
+    // DPMS does not tell anyone when the monitors come back on
+    if (dpmsOff && !saverOn && (timeout < 0 || timeout > DPMS_POLL_INTERVAL)) {
+        timeout = DPMS_POLL_INTERVAL;
+    }
+
+    XFlush(dpy);
+    struct pollfd fds[3];
+    int count = 0;
+    fds[count++] = { ConnectionNumber(dpy), POLLIN, 0 };
+    if (wakeFd >= 0) {
+        fds[count++] = { wakeFd, POLLIN, 0 };
+    }
+#ifdef XANIM_LOGIND
+    if (bus) {
+        fds[count++] = { sd_bus_get_fd(bus), (short)sd_bus_get_events(bus), 0 };
+    }
+#endif
+
+    // signals interrupt the poll, so SDL_QUIT is noticed right away
+    poll(fds, count, timeout);
+
+    updateDpms(dpmsOff);
+    return visible();
+}
+
+void ScreenWatcher::updateSaver()
+{
+    while (XPending(dpy)) {
+        XEvent event;
+        XNextEvent(dpy, &event);
+        if (saverEvent >= 0 && event.type == saverEvent + ScreenSaverNotify) {
+            int state = ((XScreenSaverNotifyEvent*)&event)->state;
+            saverOn = state == ScreenSaverOn || state == ScreenSaverCycle;
+        }
+    }
+}
+
+void ScreenWatcher::updateDpms(bool force)
+{
+    if (!hasDpms) {
+        return;
+    }
+
+    // every check is a round trip to the server
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!force && now - dpmsChecked < std::chrono::milliseconds(DPMS_CHECK_INTERVAL)) {
+        return;
+    }
+    dpmsChecked = now;
+
+    CARD16 level;
+    BOOL enabled;
+    dpmsOff = DPMSInfo(dpy, &level, &enabled) && enabled && level != DPMSModeOn;
+}
+
+void ScreenWatcher::updateLocked(bool force)
+{
+#ifdef XANIM_LOGIND
+    // any change of the session properties makes us ask again
+    bool changed = force;
+    int r;
+    while ((r = sd_bus_process(bus, NULL)) > 0) {
+        changed = true;
+    }
+
+    if (r < 0) {
+        logWarning() << "lost connection to logind, no longer watching the session lock state\n";
+        bus = sd_bus_flush_close_unref(bus);
+        locked = false;
+        return;
+    }
+
+    if (!changed) {
+        return;
+    }
+
+    int hint = 0;
+    if (sd_bus_get_property_trivial(bus, LOGIND_SERVICE, sessionPath.c_str(), LOGIND_SESSION,
+                                    "LockedHint", NULL, 'b', &hint) >= 0) {
+        locked = hint;
+    }
+#endif
+}
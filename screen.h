@@ -0,0 +1,47 @@
+#ifndef SCREEN_H_INCLUDED
+#define SCREEN_H_INCLUDED
+
+#include "xanim.h"
+
+#include <chrono>
+#include <string>
+
+// only used with XANIM_LOGIND, but the class looks the same either way
+struct sd_bus;
+
+// watches whether anything drawn on the root window can be seen, which is
+// not the case while the screen saver runs, the monitors are powered off by
+// DPMS or logind considers the session locked
+class ScreenWatcher {
+public:
+    ScreenWatcher(Display *dpy);
+    ~ScreenWatcher();
+
+    // cheap enough to be asked before every frame
+    bool visible();
+    // blocks until the screen may have become visible, a signal arrives,
+    // wakeFd becomes readable or timeout ms passed, -1 waiting without a
+    // limit; returns visible()
+    bool wait(int timeout, int wakeFd = -1);
+
+private:
+    void updateSaver();
+    void updateDpms(bool force);
+
+    Display *dpy;
+
+    int saverEvent = -1; // first event of MIT-SCREEN-SAVER, -1 if missing
+    bool saverOn = false;
+
+    bool hasDpms = false;
+    bool dpmsOff = false;
+    std::chrono::steady_clock::time_point dpmsChecked;
+
+    void updateLocked(bool force);
+
+    sd_bus *bus = nullptr; // logind connection
+    std::string sessionPath;
+    bool locked = false;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef SPSCQUEUE_H_INCLUDED
+#define SPSCQUEUE_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <stddef.h>
+
+// bounded lock-free queue for exactly one producing and one consuming thread
+template<typename T>
+class SpscQueue {
+public:
+    // one slot always stays empty to tell a full queue from an empty one
+    explicit SpscQueue(size_t capacity)
+        : slots(capacity + 1) {}
+
+    // returns false if the queue is full
+    bool push(const T &value)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = t + 1 == slots.size() ? 0 : t + 1;
+        if (next == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        slots[t] = value;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // returns false if the queue is empty
+    bool pop(T &value)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = slots[h];
+        head.store(h + 1 == slots.size() ? 0 : h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> slots;
+
+    // producer and consumer indices live on separate cache lines
+    std::atomic<size_t> head { 0 };
+    char padding[64];
+    std::atomic<size_t> tail { 0 };
+};
+
+// lets one side of a queue sleep until the other side made progress; the
+// notifying side only touches the mutex if somebody is actually asleep
+class Parking {
+public:
+    template<typename Predicate>
+    void wait(Predicate ready)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        parked.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(lock, ready);
+        parked.store(false);
+    }
+
+    // like wait, but gives up at the deadline
+    template<typename Predicate>
+    void waitUntil(std::chrono::steady_clock::time_point deadline, Predicate ready)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        parked.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait_until(lock, deadline, ready);
+        parked.store(false);
+    }
+
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            cv.notify_one();
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<bool> parked { false };
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "stats.h"
+#include "log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t printRequested = 0;
+
+static void requestPrint(int)
+{
+    printRequested = 1;
+}
+
+static double milliseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// resident set size of the process in bytes, 0 if unknown
+static size_t residentSetSize()
+{
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) {
+        return 0;
+    }
+
+    unsigned long size, resident = 0;
+    if (fscanf(f, "%lu %lu", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(f);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// user and system time of every thread in seconds
+static double cpuTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void Histogram::add(std::chrono::steady_clock::duration duration)
+{
+    double ms = milliseconds(duration);
+    double us = ms * 1000;
+    int bucket = us < 1 ? 0 : std::min(HISTOGRAM_BUCKETS - 1, (int)(log2(us) * 8));
+
+    buckets[bucket]++;
+    total++;
+    sum += ms;
+    maximum = std::max(maximum, ms);
+}
+
+double Histogram::percentile(double p) const
+{
+    if (total == 0) {
+        return 0;
+    }
+
+    // the middle of the bucket holding the p-th duration
+    uint64_t rank = std::max<uint64_t>(1, ceil(p / 100 * total)), seen = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return std::min(maximum, exp2((bucket + 0.5) / 8) / 1000);
+        }
+    }
+
+    return maximum;
+}
+
+double Histogram::mean() const
+{
+    return total > 0 ? sum / total : 0;
+}
+
+PlaybackStats::PlaybackStats(const FrameScheduler *scheduler, const Video *video, const std::string &file, int interval)
+    : scheduler(scheduler), video(video), file(file), interval(interval)
+{
+    started = written = std::chrono::steady_clock::now();
+    startCpu = cpuTime();
+
+    // no SA_RESTART, so the signal also wakes up a paused playback
+    struct sigaction action = {};
+    action.sa_handler = requestPrint;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+}
+
+void PlaybackStats::addPresent(std::chrono::steady_clock::duration duration)
+{
+    presents.add(duration);
+}
+
+void PlaybackStats::addWakeup(std::chrono::steady_clock::duration duration)
+{
+    wakeups.add(duration);
+}
+
+void PlaybackStats::update()
+{
+    if (printRequested) {
+        printRequested = 0;
+        print(std::cout);
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!file.empty() && now - written >= interval) {
+        written = now;
+        writeFile();
+    }
+}
+
+void PlaybackStats::print(std::ostream &out) const
+{
+    double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    double cpu = cpuTime();
+    size_t resident = video->frames ? video->frames->residentBytes() : 0;
+
+    out << std::fixed << std::setprecision(2)
+        << "playback statistics after " << uptime << " s:\n"
+        << "  frames presented " << presents.count() << ", late " << scheduler->lateFrames()
+        << ", dropped " << scheduler->droppedFrames() << "\n";
+    for (const std::pair<const char*, const Histogram*> &histogram :
+         { std::make_pair("present", &presents), std::make_pair("wakeup ", &wakeups) }) {
+        out << "  " << histogram.first << " ms p50 " << histogram.second->percentile(50)
+            << ", p90 " << histogram.second->percentile(90) << ", p99 " << histogram.second->percentile(99)
+            << ", max " << histogram.second->max() << ", mean " << histogram.second->mean() << "\n";
+    }
+    out << "  frames resident " << resident / (1024 * 1024) << " MiB, rss " << residentSetSize() / (1024 * 1024)
+        << " MiB, cpu time " << cpu << " s, " << (uptime > 0 ? (cpu - startCpu) / uptime * 100 : 0)
+        << "% of a core since playback started\n";
+    out << std::defaultfloat;
+}
+
+void PlaybackStats::writeJson(std::ostream &out) const
+{
+    double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    size_t resident = video->frames ? video->frames->residentBytes() : 0;
+
+    out << std::fixed << std::setprecision(3)
+        << "{\n"
+        << "  \"uptime\": " << uptime << ",\n"
+        << "  \"presented\": " << presents.count() << ",\n"
+        << "  \"late\": " << scheduler->lateFrames() << ",\n"
+        << "  \"dropped\": " << scheduler->droppedFrames() << ",\n";
+    for (const std::pair<const char*, const Histogram*> &histogram :
+         { std::make_pair("present_ms", &presents), std::make_pair("wakeup_ms", &wakeups) }) {
+        out << "  \"" << histogram.first << "\": { \"p50\": " << histogram.second->percentile(50)
+            << ", \"p90\": " << histogram.second->percentile(90) << ", \"p99\": " << histogram.second->percentile(99)
+            << ", \"max\": " << histogram.second->max() << ", \"mean\": " << histogram.second->mean() << " },\n";
+    }
+    out << "  \"resident_bytes\": " << resident << ",\n"
+        << "  \"rss_bytes\": " << residentSetSize() << ",\n"
+        << "  \"cpu_seconds\": " << cpuTime() << ",\n"
+        << "  \"playback_cpu_seconds\": " << cpuTime() - startCpu << "\n"
+        << "}\n";
+}
+
+void PlaybackStats::writeFile() const
+{
+    // readers never see a half written file
+    std::string temporary = file + ".tmp";
+    {
+        std::ofstream out(temporary);
+        writeJson(out);
+        if (!out) {
+            logWarning() << "failed to write stats file " << temporary << "\n";
+            return;
+        }
+    }
+
+    if (rename(temporary.c_str(), file.c_str()) != 0) {
+        logWarning() << "failed to replace stats file " << file << "\n";
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+#include "video.h"
+#include "scheduler.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+
+#include <stdint.h>
+
+// durations from 1 us up to about two minutes, in 8 buckets per doubling
+const int HISTOGRAM_BUCKETS = 27 * 8;
+
+// counts durations in logarithmic buckets, so percentiles cost no memory
+// however long xanim runs; they are accurate to about 5%
+class Histogram {
+public:
+    void add(std::chrono::steady_clock::duration);
+
+    size_t count() const { return total; }
+    // in ms; 0 if nothing was added
+    double percentile(double p) const;
+    double mean() const;
+    double max() const { return maximum; }
+
+private:
+    uint64_t buckets[HISTOGRAM_BUCKETS] = {};
+    size_t total = 0;
+    double sum = 0, maximum = 0;
+};
+
+// collects what the render loop does; SIGUSR1 prints everything and a
+// stats file is rewritten every few seconds
+class PlaybackStats {
+public:
+    // installs the SIGUSR1 handler; an empty file writes no stats file,
+    // otherwise it is rewritten every interval seconds
+    PlaybackStats(const FrameScheduler *scheduler, const Video *video, const std::string &file, int interval);
+
+    // time from starting to draw a frame until the present returned
+    void addPresent(std::chrono::steady_clock::duration);
+    // how late the loop woke up for a frame
+    void addWakeup(std::chrono::steady_clock::duration);
+
+    // prints the statistics if SIGUSR1 arrived since the last call and
+    // rewrites the stats file if it is due; cheap enough for every frame
+    void update();
+
+    void print(std::ostream&) const;
+    void writeJson(std::ostream&) const;
+
+private:
+    void writeFile() const;
+
+    const FrameScheduler *scheduler;
+    const Video *video;
+    std::string file;
+    std::chrono::seconds interval;
+
+    std::chrono::steady_clock::time_point started, written;
+    double startCpu; // cpu time spent loading, in seconds
+    Histogram presents, wakeups;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "stream.h"
+#include "log.h"
+
+#include <algorithm>
+
+PixelFormat streamFormat(const RenderContext &rc, PixelFormat format)
+{
+    if (format == PixelFormat::RGB24 && rc.sdlr && nativeFormat(rc, PixelFormat::XRGB32)) {
+        return PixelFormat::XRGB32;
+    }
+
+    return format;
+}
+
+bool directUpload(const RenderContext &rc, PixelFormat format)
+{
+    // planar formats are uploaded from the decoder buffers without a copy
+    // anyway, as the rows of their planes have to be tightly packed
+    return rc.sdlr && (format == PixelFormat::XRGB32 || format == PixelFormat::RGB565) && nativeFormat(rc, format);
+}
+
+StreamStore::StreamStore(const RenderContext &rc, Decoder *decoder)
+    : rc(rc), decoder(decoder), direct(directUpload(rc, decoder->format))
+{
+    if (direct) {
+        unlent = decoder->takeBuffers();
+    }
+
+    // the first call to next() wraps around to frame 0
+    cursor = decoder->frameCount() - 1;
+}
+
+StreamStore::~StreamStore()
+{
+    // the decoder may still write into locked pool textures
+    delete decoder;
+
+    for (SDL_Texture *texture : head) {
+        SDL_DestroyTexture(texture);
+    }
+    for (SDL_Texture *texture : uploads) {
+        if (texture) {
+            SDL_DestroyTexture(texture);
+        }
+    }
+    for (SDL_Texture *texture : pool) {
+        SDL_DestroyTexture(texture);
+    }
+}
+
+bool StreamStore::load(std::chrono::steady_clock::time_point until)
+{
+    if (loaded) {
+        return false;
+    }
+
+    // every texture costs about as much as a frame upload, so the deadline
+    // is checked after each one
+    while (std::chrono::steady_clock::now() < until) {
+        if (!unlent.empty()) {
+            PixelBuffer *buffer = unlent.back();
+            buffer->owner = createStreamingTexture();
+            if (!buffer->owner) {
+                return false;
+            }
+            pool.push_back((SDL_Texture*)buffer->owner);
+            unlent.pop_back();
+            lend(buffer);
+            continue;
+        }
+        if (!started) {
+            decoder->start(true, STREAM_HEAD_FRAMES);
+            started = true;
+        }
+
+        if (head.size() < STREAM_HEAD_FRAMES) {
+            PixelBuffer *buffer = decoder->pop();
+            if (!buffer) {
+                if (decoder->done() && !decoder->hasFrames()) {
+                    logWarning() << "failed to decode frame " << head.size() << "\n";
+                    return false;
+                }
+                decoder->waitUntil(until);
+                continue;
+            }
+            if (!addHead(buffer)) {
+                return false;
+            }
+            continue;
+        }
+
+        if (!direct) {
+            for (SDL_Texture *&texture : uploads) {
+                texture = createStreamingTexture();
+                if (!texture) {
+                    return false;
+                }
+            }
+        }
+        loaded = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool StreamStore::addHead(PixelBuffer *buffer)
+{
+    // the head is never decoded again, so it uses regular static textures
+    // or keeps the pool textures it was decoded into
+    if (direct) {
+        SDL_Texture *texture = (SDL_Texture*)buffer->owner;
+        SDL_UnlockTexture(texture);
+        head.push_back(texture);
+        pool.erase(std::find(pool.begin(), pool.end(), texture));
+
+        buffer->owner = createStreamingTexture();
+        if (!buffer->owner) {
+            return false;
+        }
+        pool.push_back((SDL_Texture*)buffer->owner);
+        lend(buffer);
+        return true;
+    }
+
+    SDL_Texture *texture = createTexture(rc, decoder->format, buffer->pixels[0], decoder->width, decoder->height);
+    decoder->release(buffer);
+    if (!texture) {
+        logWarning() << "Texture of frame " << head.size() << " could not be created\n";
+        return false;
+    }
+    head.push_back(texture);
+    return true;
+}
+
+SDL_Texture *StreamStore::createStreamingTexture() const
+{
+    SDL_Texture *texture = SDL_CreateTexture(rc.sdlr, sdlFormat(decoder->format), SDL_TEXTUREACCESS_STREAMING,
+                                             decoder->width, decoder->height);
+    if (!texture) {
+        logWarning() << "failed to create streaming texture: " << SDL_GetError() << "\n";
+    }
+
+    return texture;
+}
+
+void StreamStore::lend(PixelBuffer *buffer)
+{
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture((SDL_Texture*)buffer->owner, NULL, &pixels, &pitch) != 0) {
+        logError() << "failed to lock streaming texture: " << SDL_GetError() << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    buffer->pixels[0] = (uint8_t*)pixels;
+    buffer->pitch = pitch;
+    decoder->release(buffer);
+}
+
+bool StreamStore::next()
+{
+    if (!loaded) {
+        return false;
+    }
+
+    size_t nextFrame = cursor + 1 < decoder->frameCount() ? cursor + 1 : 0;
+    if (nextFrame < head.size()) {
+        cursor = nextFrame;
+        current = head[cursor];
+        return true;
+    }
+
+    if (!pending) {
+        pending = decoder->pop();
+    }
+
+    // the decoder fell behind, so hold the current frame
+    if (!pending) {
+        return false;
+    }
+
+    // the decoder found the real end of the video before we did
+    if (pending->frame != nextFrame) {
+        cursor = 0;
+        current = head[cursor];
+        return true;
+    }
+
+    if (direct) {
+        // unlocking uploads what the decoder wrote; the texture shown two
+        // frames ago is not read anymore and takes the next frame
+        current = (SDL_Texture*)pending->owner;
+        SDL_UnlockTexture(current);
+        if (shown[STREAM_SHOWN_FRAMES - 1]) {
+            lend(shown[STREAM_SHOWN_FRAMES - 1]);
+        }
+        for (size_t i = STREAM_SHOWN_FRAMES - 1; i > 0; i--) {
+            shown[i] = shown[i - 1];
+        }
+        shown[0] = pending;
+    } else {
+        uploadIndex = (uploadIndex + 1) % STREAM_SHOWN_FRAMES;
+        SDL_UpdateTexture(uploads[uploadIndex], NULL, pending->pixels[0], framePitch(decoder->format, decoder->width));
+        decoder->release(pending);
+        current = uploads[uploadIndex];
+    }
+    pending = nullptr;
+
+    cursor = nextFrame;
+    return true;
+}
+
+SDL_Texture *StreamStore::texture(int width, int height)
+{
+    return current;
+}
+
+size_t StreamStore::residentBytes() const
+{
+    size_t bytes = decoder->bufferBytes();
+    for (SDL_Texture *texture : head) {
+        bytes += textureMemory(texture);
+    }
+    for (SDL_Texture *texture : uploads) {
+        bytes += textureMemory(texture);
+    }
+    for (SDL_Texture *texture : pool) {
+        bytes += textureMemory(texture);
+    }
+
+    return bytes;
+}
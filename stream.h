@@ -0,0 +1,71 @@
+#ifndef STREAM_H_INCLUDED
+#define STREAM_H_INCLUDED
+
+#include "video.h"
+#include "decoder.h"
+
+// number of frames at the start of the video which always stay resident so
+// the loop can wrap around while the decoder seeks back
+const size_t STREAM_HEAD_FRAMES = 8;
+// streamed frames the renderer may still read from: the one on screen and
+// the one before it
+const size_t STREAM_SHOWN_FRAMES = 2;
+
+// format streamed frames are decoded to; 24 bit RGB is widened to the 32 bit
+// layout renderers take as is, so it can be written into textures directly
+PixelFormat streamFormat(const RenderContext&, PixelFormat);
+// whether frames of the format are decoded straight into locked streaming
+// textures instead of being uploaded from buffers of the decoder; the
+// decoder then needs STREAM_SHOWN_FRAMES buffers more than the window
+bool directUpload(const RenderContext&, PixelFormat);
+
+// plays a video without preloading it; only the first few frames stay
+// resident while the decoder thread keeps a fixed window of frames ahead of
+// the play cursor, so memory stays flat for any video length
+class StreamStore : public FrameStore {
+public:
+    // takes ownership of a decoder which has not been started yet; nothing
+    // is created before the first call to load()
+    StreamStore(const RenderContext&, Decoder *decoder);
+    ~StreamStore();
+
+    bool next() override;
+    SDL_Texture *texture(int width, int height) override;
+    size_t residentBytes() const override;
+    // creates the textures the decoder writes into, one at a time, then
+    // starts it and uploads the head as its frames arrive
+    bool load(std::chrono::steady_clock::time_point until) override;
+    // the head was uploaded
+    bool ready() const override { return loaded; }
+
+private:
+    SDL_Texture *createStreamingTexture() const;
+    // locks the texture of a buffer and lets the decoder write into it
+    void lend(PixelBuffer*);
+    // keeps a decoded frame of the head; returns false if it has no texture
+    bool addHead(PixelBuffer*);
+
+    const RenderContext &rc;
+    Decoder *decoder;
+    bool direct;
+    bool started = false; // the decoder was started
+    bool loaded = false;
+    std::vector<PixelBuffer*> unlent; // buffers which have no texture yet
+
+    std::vector<SDL_Texture*> head; // first frames of the video
+    // frames are uploaded alternately so a texture the renderer may still
+    // read from is never overwritten
+    SDL_Texture *uploads[STREAM_SHOWN_FRAMES] = {};
+    int uploadIndex = 0;
+
+    // with direct uploads, every decoder buffer points into a texture of the
+    // pool; the shown ones go back to the decoder once they are off screen
+    std::vector<SDL_Texture*> pool;
+    PixelBuffer *shown[STREAM_SHOWN_FRAMES] = {};
+
+    PixelBuffer *pending = nullptr; // decoded frame which is not due yet
+    SDL_Texture *current = nullptr;
+    size_t cursor; // frame currently shown
+};
+
+#endif
@@ -0,0 +1,351 @@
+#include "timeline.h"
+#include "budget.h"
+#include "log.h"
+
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+TimelineBuilder::TimelineBuilder(const RenderContext &rc, TextureStore *store, int threshold, size_t budget)
+    : rc(rc), store(store), threshold(threshold), budget(budget)
+{
+    store->sdlr = rc.sdlr;
+    store->maxMemory = budget;
+    packed.resize(store->variants.size(), 0);
+
+    // every small frame in a texture of its own costs a driver allocation
+    // and a bind; an atlas holds as many of them as the renderer allows
+    SDL_RendererInfo info;
+    if (!rc.sdlr || SDL_GetRendererInfo(rc.sdlr, &info) != 0) {
+        return;
+    }
+    for (TextureStore::Variant &variant : store->variants) {
+        if (variant.width > ATLAS_FRAME_SIZE || variant.height > ATLAS_FRAME_SIZE) {
+            continue;
+        }
+
+        // 0 means the renderer sets no limit
+        int maxWidth = info.max_texture_width > 0 ? std::min(ATLAS_SIZE, info.max_texture_width) : ATLAS_SIZE;
+        int maxHeight = info.max_texture_height > 0 ? std::min(ATLAS_SIZE, info.max_texture_height) : ATLAS_SIZE;
+        int columns = std::min(ATLAS_GRID, maxWidth / variant.width);
+        int rows = std::min(ATLAS_GRID, maxHeight / variant.height);
+        if (columns * rows > 1) {
+            variant.atlasColumns = columns;
+            variant.atlasRows = rows;
+        }
+    }
+}
+
+bool TimelineBuilder::add(size_t frame, const std::vector<uint8_t*> &pixels)
+{
+    if (frame >= frames.size()) {
+        frames.resize(frame + 1, SIZE_MAX);
+    }
+
+    // the largest variant tells frames apart best
+    const TextureStore::Variant &largest = store->variants[0];
+    uint64_t hash = hashBytes(pixels[0], frameBytes(store->format, largest.width, largest.height));
+
+    auto distinct = hashes.find(hash);
+    if (distinct != hashes.end()) {
+        frames[frame] = distinct->second;
+        loaded++;
+        return true;
+    }
+
+    size_t textureSize = 0, pixelSize = 0;
+    for (size_t i = 0; i < store->variants.size(); i++) {
+        const TextureStore::Variant &variant = store->variants[i];
+        textureSize += textureCost(i);
+        pixelSize += frameBytes(store->format, variant.width, variant.height);
+    }
+
+    // plain pixels are never larger and can be swapped out, unlike memory
+    // of the graphics driver
+    bool spill = budget > 0 && bytes() + textureSize > budget;
+    if (spill && bytes() + pixelSize > budget) {
+        cut = true;
+        return false;
+    }
+
+    std::vector<SDL_Texture*> textures;
+    std::vector<SDL_Rect> regions;
+    for (size_t i = 0; i < store->variants.size() && !spill; i++) {
+        const TextureStore::Variant &variant = store->variants[i];
+        SDL_Rect region = { 0, 0, variant.width, variant.height };
+        SDL_Texture *texture = variant.atlasColumns > 0
+            ? pack(i, pixels[i], &region)
+            : createTexture(rc, store->format, pixels[i], variant.width, variant.height);
+        if (!texture) {
+            // cells of atlases are simply taken by the next frame
+            for (size_t j = 0; j < textures.size(); j++) {
+                if (store->variants[j].atlasColumns == 0) {
+                    SDL_DestroyTexture(textures[j]);
+                }
+            }
+            return false;
+        }
+        textures.push_back(texture);
+        regions.push_back(region);
+    }
+
+    size_t index = store->variants[0].sdlTextures.size();
+    for (size_t i = 0; i < store->variants.size(); i++) {
+        TextureStore::Variant &variant = store->variants[i];
+        if (spill) {
+            variant.sdlTextures.push_back(nullptr);
+            variant.regions.push_back({ 0, 0, variant.width, variant.height });
+            variant.spilled.resize(index + 1);
+            variant.spilled[index].assign(pixels[i], pixels[i] + frameBytes(store->format, variant.width, variant.height));
+        } else {
+            variant.sdlTextures.push_back(textures[i]);
+            variant.regions.push_back(regions[i]);
+            if (variant.atlasColumns > 0) {
+                packed[i]++;
+            }
+        }
+    }
+    if (spill) {
+        spilledBytes += pixelSize;
+    } else {
+        texturesBytes += textureSize;
+    }
+
+    if (threshold > 0) {
+        thumbnails.resize((index + 1) * THUMBNAIL_SIZE * THUMBNAIL_SIZE * 3);
+        thumbnail(pixels[0], largest.width, largest.height, &thumbnails[index * THUMBNAIL_SIZE * THUMBNAIL_SIZE * 3]);
+    }
+
+    hashes[hash] = index;
+    frames[frame] = index;
+    loaded++;
+    return true;
+}
+
+bool TimelineBuilder::extend()
+{
+    size_t before = appended;
+    append(false);
+    return appended > before;
+}
+
+void TimelineBuilder::finish()
+{
+    append(true);
+
+    // frames which were merged into a similar one are not needed anymore
+    std::vector<TextureStore::Entry> &timeline = store->timeline;
+    size_t distinctCount = store->variants[0].sdlTextures.size();
+    std::vector<size_t> remap(distinctCount, SIZE_MAX);
+    size_t used = 0;
+    for (TextureStore::Entry &entry : timeline) {
+        if (remap[entry.texture] == SIZE_MAX) {
+            remap[entry.texture] = used++;
+        }
+        entry.texture = remap[entry.texture];
+    }
+
+    for (TextureStore::Variant &variant : store->variants) {
+        std::vector<SDL_Texture*> textures(used);
+        std::vector<SDL_Rect> regions(used);
+        std::vector<std::vector<uint8_t>> spilled(variant.spilled.empty() ? 0 : used);
+        for (size_t i = 0; i < distinctCount; i++) {
+            if (remap[i] != SIZE_MAX) {
+                textures[remap[i]] = variant.sdlTextures[i];
+                regions[remap[i]] = variant.regions[i];
+                if (i < variant.spilled.size()) {
+                    spilled[remap[i]] = std::move(variant.spilled[i]);
+                }
+            } else if (variant.sdlTextures[i] && variant.atlasColumns == 0) {
+                // cells of atlases stay unused
+                SDL_DestroyTexture(variant.sdlTextures[i]);
+            }
+        }
+        variant.sdlTextures = std::move(textures);
+        variant.regions = std::move(regions);
+        variant.spilled = std::move(spilled);
+
+        // the store may already have played part of the timeline
+        for (TextureStore::Slot &slot : variant.slots) {
+            slot.frame = slot.frame < distinctCount ? remap[slot.frame] : SIZE_MAX;
+        }
+    }
+
+    std::vector<uint64_t> shown(used, 0);
+    for (size_t i = 0; i < store->shown.size(); i++) {
+        if (remap[i] != SIZE_MAX) {
+            shown[remap[i]] = store->shown[i];
+        }
+    }
+    store->shown = std::move(shown);
+
+    frames.clear();
+    hashes.clear();
+    thumbnails.clear();
+}
+
+void TimelineBuilder::append(bool skipGaps)
+{
+    const int thumbnailBytes = THUMBNAIL_SIZE * THUMBNAIL_SIZE * 3;
+
+    std::vector<TextureStore::Entry> &timeline = store->timeline;
+    for (; appended < frames.size(); appended++) {
+        size_t index = frames[appended];
+        if (index == SIZE_MAX) {
+            if (!skipGaps) {
+                return;
+            }
+            continue;
+        }
+
+        if (!timeline.empty()) {
+            // compared against the frame which is shown, so small changes
+            // can not add up over a long run
+            size_t shownIndex = timeline.back().texture;
+            bool similar = shownIndex == index;
+            if (!similar && threshold > 0) {
+                const uint8_t *a = &thumbnails[shownIndex * thumbnailBytes];
+                const uint8_t *b = &thumbnails[index * thumbnailBytes];
+                int difference = 0;
+                for (int i = 0; i < thumbnailBytes; i++) {
+                    difference += abs(a[i] - b[i]);
+                }
+                similar = difference <= threshold * thumbnailBytes;
+            }
+
+            if (similar) {
+                timeline.back().duration++;
+                continue;
+            }
+        }
+
+        timeline.push_back({ index, 1 });
+    }
+}
+
+size_t TimelineBuilder::textureCost(size_t index) const
+{
+    const TextureStore::Variant &variant = store->variants[index];
+    if (variant.atlasColumns == 0) {
+        return textureBytes(store->format, variant.width, variant.height);
+    }
+
+    // a whole atlas is taken at once, after that its cells cost nothing
+    size_t cells = variant.atlasColumns * variant.atlasRows;
+    return packed[index] / cells < variant.atlases.size()
+        ? 0
+        : textureBytes(store->format, variant.width * variant.atlasColumns, variant.height * variant.atlasRows);
+}
+
+SDL_Texture *TimelineBuilder::pack(size_t index, uint8_t *pixels, SDL_Rect *region)
+{
+    TextureStore::Variant &variant = store->variants[index];
+    size_t cells = variant.atlasColumns * variant.atlasRows;
+    size_t atlas = packed[index] / cells, cell = packed[index] % cells;
+
+    if (atlas == variant.atlases.size()) {
+        SDL_Texture *texture = SDL_CreateTexture(rc.sdlr, sdlFormat(store->format), SDL_TEXTUREACCESS_STATIC,
+                                                 variant.width * variant.atlasColumns,
+                                                 variant.height * variant.atlasRows);
+        if (!texture) {
+            logError() << "Atlas texture could not be created: " << SDL_GetError() << "\n";
+            return nullptr;
+        }
+        variant.atlases.push_back(texture);
+    }
+
+    *region = { (int)(cell % variant.atlasColumns) * variant.width, (int)(cell / variant.atlasColumns) * variant.height,
+                variant.width, variant.height };
+    if (SDL_UpdateTexture(variant.atlases[atlas], region, pixels, framePitch(store->format, variant.width)) != 0) {
+        logError() << "Atlas texture could not be updated: " << SDL_GetError() << "\n";
+        return nullptr;
+    }
+
+    return variant.atlases[atlas];
+}
+
+void TimelineBuilder::thumbnail(const uint8_t *pixels, int width, int height, uint8_t *out) const
+{
+    // a sparse grid of samples is enough to tell how a frame looks
+    int stepX = std::max(1, width / (THUMBNAIL_SIZE * 8));
+    int stepY = std::max(1, height / (THUMBNAIL_SIZE * 8));
+
+    std::vector<uint32_t> sums(THUMBNAIL_SIZE * THUMBNAIL_SIZE * 3, 0);
+    std::vector<uint32_t> counts(THUMBNAIL_SIZE * THUMBNAIL_SIZE, 0);
+    for (int y = 0; y < height; y += stepY) {
+        int cellY = y * THUMBNAIL_SIZE / height;
+        for (int x = 0; x < width; x += stepX) {
+            int cell = cellY * THUMBNAIL_SIZE + x * THUMBNAIL_SIZE / width;
+            uint8_t sample[3];
+            samplePixel(pixels, width, height, x, y, sample);
+            for (int c = 0; c < 3; c++) {
+                sums[cell * 3 + c] += sample[c];
+            }
+            counts[cell]++;
+        }
+    }
+
+    for (int cell = 0; cell < THUMBNAIL_SIZE * THUMBNAIL_SIZE; cell++) {
+        for (int c = 0; c < 3; c++) {
+            out[cell * 3 + c] = counts[cell] ? sums[cell * 3 + c] / counts[cell] : 0;
+        }
+    }
+}
+
+void TimelineBuilder::samplePixel(const uint8_t *pixels, int width, int height, int x, int y, uint8_t *out) const
+{
+    // any three channels do to compare frames of the same format
+    size_t luma = (size_t)width * height;
+    size_t chroma = (size_t)(y / 2) * (width / 2) + x / 2;
+    switch (store->format) {
+        case PixelFormat::IYUV:
+            out[0] = pixels[(size_t)y * width + x];
+            out[1] = pixels[luma + chroma];
+            out[2] = pixels[luma + luma / 4 + chroma];
+            break;
+
+        case PixelFormat::NV12:
+            out[0] = pixels[(size_t)y * width + x];
+            out[1] = pixels[luma + chroma * 2];
+            out[2] = pixels[luma + chroma * 2 + 1];
+            break;
+
+        case PixelFormat::RGB565: {
+            uint16_t pixel = ((const uint16_t*)pixels)[(size_t)y * width + x];
+            out[0] = (pixel >> 11) << 3;
+            out[1] = ((pixel >> 5) & 0x3f) << 2;
+            out[2] = (pixel & 0x1f) << 3;
+            break;
+        }
+
+        default:
+            memcpy(out, pixels + ((size_t)y * width + x) * 3, 3);
+            break;
+    }
+}
+
+void printTimeline(const TextureStore *store, size_t frameCount)
+{
+    size_t textures = 0, spilled = 0, packed = 0;
+    for (const TextureStore::Variant &variant : store->variants) {
+        for (size_t i = 0; i < variant.sdlTextures.size(); i++) {
+            if (!variant.sdlTextures[i]) {
+                spilled++;
+            } else if (variant.atlasColumns > 0) {
+                packed++;
+            } else {
+                textures++;
+            }
+        }
+        textures += variant.atlases.size();
+    }
+
+    logInfo() << frameCount << " frames use " << textures << " textures in " << store->timeline.size() << " timeline entries\n";
+    if (packed > 0) {
+        logInfo() << packed << " small frames are packed into atlas textures\n";
+    }
+    if (spilled > 0) {
+        logInfo() << spilled << " frames did not fit into the memory budget as textures and are uploaded when shown\n";
+    }
+}
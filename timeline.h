@@ -0,0 +1,80 @@
+#ifndef TIMELINE_H_INCLUDED
+#define TIMELINE_H_INCLUDED
+
+#include "video.h"
+
+#include <unordered_map>
+
+#include <stdint.h>
+
+// frames are shrunk to this many pixels in both directions to compare how
+// they look
+const int THUMBNAIL_SIZE = 16;
+// frames at most this many pixels wide and high are packed into atlases
+const int ATLAS_FRAME_SIZE = 512;
+// frames an atlas holds in both directions at most, so short videos do not
+// leave most of it empty
+const int ATLAS_GRID = 8;
+// pixels an atlas is wide and high at most, unless the renderer allows less
+const int ATLAS_SIZE = 2048;
+
+// fills a TextureStore with the distinct frames of a video, which may be
+// added in any order; repeated frames share a single texture and runs of
+// them become a single timeline entry; small frames are packed into a few
+// atlas textures instead of one texture each
+class TimelineBuilder {
+public:
+    // the store needs its variants but no textures; consecutive frames whose
+    // thumbnails differ by at most threshold on average are merged, 0 only
+    // merges exact repeats; once textures would take more than budget bytes,
+    // 0 meaning no limit, frames are spilled into plain pixels, and once
+    // those do not fit either the video is cut
+    TimelineBuilder(const RenderContext&, TextureStore *store, int threshold, size_t budget = 0);
+
+    // adds a frame in the store's format for every variant; returns
+    // false if its textures could not be created or it did not fit
+    bool add(size_t frame, const std::vector<uint8_t*> &pixels);
+    // appends the frames which were added without a gap since the last call
+    // to the timeline of the store, so that part can play while the rest is
+    // added; returns false if there were none
+    bool extend();
+    // completes the timeline of the store, skipping missing frames, and
+    // drops textures no entry uses; positions in the timeline stay the same
+    void finish();
+
+    size_t frameCount() const { return loaded; }
+    // whether a frame was dropped to stay within the budget
+    bool full() const { return cut; }
+    // memory taken by textures and spilled frames
+    size_t bytes() const { return texturesBytes + spilledBytes; }
+
+private:
+    // appends frames up to the first missing one or, with skipGaps, all of
+    // them to the timeline of the store
+    void append(bool skipGaps);
+    // memory the textures of a new frame take in the given variant
+    size_t textureCost(size_t variant) const;
+    // uploads a frame into the next free cell of the atlases of a variant
+    SDL_Texture *pack(size_t variant, uint8_t *pixels, SDL_Rect *region);
+    void thumbnail(const uint8_t *pixels, int width, int height, uint8_t *out) const;
+    void samplePixel(const uint8_t *pixels, int width, int height, int x, int y, uint8_t *out) const;
+
+    const RenderContext &rc;
+    TextureStore *store;
+    int threshold;
+    size_t budget;
+    size_t texturesBytes = 0, spilledBytes = 0;
+    bool cut = false;
+
+    std::vector<size_t> frames; // index of the distinct frame for every frame, SIZE_MAX if missing
+    std::unordered_map<uint64_t, size_t> hashes; // distinct frame of every hash
+    std::vector<uint8_t> thumbnails; // one per distinct frame
+    size_t loaded = 0;
+    size_t appended = 0; // frames which are part of the timeline
+    std::vector<size_t> packed; // frames in the atlases of every variant
+};
+
+// prints how many textures the frames of a finished store use
+void printTimeline(const TextureStore*, size_t frameCount);
+
+#endif
@@ -0,0 +1,891 @@
+#include "video.h"
+#include "stream.h"
+#include "cache.h"
+#include "delta.h"
+#include "compress.h"
+#include "timeline.h"
+#include "budget.h"
+#include "gif.h"
+#include "progressive.h"
+#include "log.h"
+
+#include <algorithm>
+#include <map>
+
+#include <string.h>
+
+// streaming textures kept for the spilled frames of each variant
+const size_t SPILL_SLOTS = 4;
+// frames between checks whether textures outgrew the memory budget
+const uint64_t EVICT_CHECK_FRAMES = 64;
+
+TextureStore::~TextureStore()
+{
+    for (Variant &variant : variants) {
+        for (SDL_Texture *texture : variant.sdlTextures) {
+            if (texture && variant.atlasColumns == 0) {
+                SDL_DestroyTexture(texture);
+            }
+        }
+        for (SDL_Texture *atlas : variant.atlases) {
+            SDL_DestroyTexture(atlas);
+        }
+        for (Slot &slot : variant.slots) {
+            SDL_DestroyTexture(slot.texture);
+        }
+    }
+}
+
+bool TextureStore::next()
+{
+    cursor = cursor + 1 < timeline.size() ? cursor + 1 : 0;
+    tick++;
+
+    // frames may still be added while the first ones play
+    shown.resize(variants[0].sdlTextures.size(), 0);
+    shown[timeline[cursor].texture] = tick;
+
+    // textures can take more than the builder estimated, and spilled frames
+    // add their slots; reading a texture back stalls the renderer, so a
+    // single frame is spilled per frame period
+    if (maxMemory > 0 && (overBudget || tick % EVICT_CHECK_FRAMES == 0)) {
+        overBudget = residentBytes() > maxMemory && evict();
+    }
+
+    return true;
+}
+
+SDL_Texture *TextureStore::texture(int width, int height)
+{
+    size_t index = timeline[cursor].texture;
+
+    // no variant was made for this size, so let the renderer scale
+    Variant *match = &variants[0];
+    for (Variant &variant : variants) {
+        if (variant.width == width && variant.height == height) {
+            match = &variant;
+            break;
+        }
+    }
+
+    shownRegion = nullptr;
+    if (match->sdlTextures[index]) {
+        if (match->atlasColumns > 0) {
+            shownRegion = &match->regions[index];
+        }
+        return match->sdlTextures[index];
+    }
+    return upload(*match, index);
+}
+
+SDL_Texture *TextureStore::upload(Variant &variant, size_t index)
+{
+    Slot *lru = nullptr;
+    for (Slot &slot : variant.slots) {
+        if (slot.frame == index) {
+            slot.used = tick;
+            return slot.texture;
+        }
+        if (!lru || slot.used < lru->used) {
+            lru = &slot;
+        }
+    }
+
+    // the least recently shown frame makes room, which is never the one
+    // drawn right now
+    if (variant.slots.size() < SPILL_SLOTS) {
+        SDL_Texture *texture = SDL_CreateTexture(sdlr, sdlFormat(format), SDL_TEXTUREACCESS_STREAMING,
+                                                 variant.width, variant.height);
+        if (texture) {
+            variant.slots.push_back({ texture, SIZE_MAX, 0 });
+            lru = &variant.slots.back();
+        } else if (!lru) {
+            logError() << "failed to create streaming texture: " << SDL_GetError() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    SDL_UpdateTexture(lru->texture, NULL, variant.spilled[index].data(), framePitch(format, variant.width));
+    lru->frame = index;
+    lru->used = tick;
+    return lru->texture;
+}
+
+// static textures can not be locked, so their pixels are drawn onto a
+// render target and read from there
+static bool readTexture(SDL_Renderer *sdlr, SDL_Texture *texture, PixelFormat format, int width, int height,
+                        uint8_t *pixels)
+{
+    SDL_Texture *target = SDL_CreateTexture(sdlr, sdlFormat(format), SDL_TEXTUREACCESS_TARGET, width, height);
+    if (!target) {
+        logWarning() << "failed to create render target texture: " << SDL_GetError() << "\n";
+        return false;
+    }
+
+    SDL_Texture *previous = SDL_GetRenderTarget(sdlr);
+    bool ok = SDL_SetRenderTarget(sdlr, target) == 0
+        && SDL_RenderCopy(sdlr, texture, NULL, NULL) == 0
+        && SDL_RenderReadPixels(sdlr, NULL, sdlFormat(format), pixels, framePitch(format, width)) == 0;
+    if (!ok) {
+        logWarning() << "failed to read back texture: " << SDL_GetError() << "\n";
+    }
+    SDL_SetRenderTarget(sdlr, previous);
+    SDL_DestroyTexture(target);
+
+    return ok;
+}
+
+bool TextureStore::evict()
+{
+    // planar frames can not be read back
+    if (!sdlr || (format != PixelFormat::RGB24 && format != PixelFormat::RGB565) || !SDL_RenderTargetSupported(sdlr)) {
+        return false;
+    }
+
+    // atlases hold many frames at once and stay, as does the frame shown now
+    size_t oldest = SIZE_MAX;
+    for (size_t i = 0; i < shown.size(); i++) {
+        bool textured = false;
+        for (const Variant &variant : variants) {
+            textured = textured || (variant.atlasColumns == 0 && variant.sdlTextures[i]);
+        }
+        if (textured && i != timeline[cursor].texture && (oldest == SIZE_MAX || shown[i] < shown[oldest])) {
+            oldest = i;
+        }
+    }
+    if (oldest == SIZE_MAX) {
+        return false;
+    }
+
+    for (Variant &variant : variants) {
+        SDL_Texture *texture = variant.sdlTextures[oldest];
+        if (!texture || variant.atlasColumns > 0) {
+            continue;
+        }
+
+        std::vector<uint8_t> pixels(frameBytes(format, variant.width, variant.height));
+        if (!readTexture(sdlr, texture, format, variant.width, variant.height, pixels.data())) {
+            return false;
+        }
+        variant.spilled.resize(std::max(variant.spilled.size(), variant.sdlTextures.size()));
+        variant.spilled[oldest] = std::move(pixels);
+        variant.sdlTextures[oldest] = nullptr;
+        SDL_DestroyTexture(texture);
+    }
+
+    logDebug() << "spilled frame " << oldest << " to stay within the memory budget\n";
+    return true;
+}
+
+int TextureStore::duration()
+{
+    return timeline[cursor].duration;
+}
+
+size_t TextureStore::residentBytes() const
+{
+    size_t bytes = 0;
+    for (const Variant &variant : variants) {
+        for (SDL_Texture *texture : variant.atlasColumns > 0 ? variant.atlases : variant.sdlTextures) {
+            bytes += textureMemory(texture);
+        }
+        for (const std::vector<uint8_t> &pixels : variant.spilled) {
+            bytes += pixels.size();
+        }
+        for (const Slot &slot : variant.slots) {
+            bytes += textureMemory(slot.texture);
+        }
+    }
+
+    return bytes;
+}
+
+static void printProperties(const RenderContext &rc, int width, int height, int channels)
+{
+    logInfo() << "image dimensions " << width << "x" << height << ", channels " << channels << "\n";
+    if (width != rc.sdlwWidth || height != rc.sdlwHeight) {
+        logInfo() << "image dimensions and window dimensions differ; frames will be rendered accordingly\n";
+    }
+}
+
+static void printRate(double source, double rate)
+{
+    if (rate != source) {
+        logInfo() << "resampling from " << source << " to " << rate << " fps; frames in between are skipped\n";
+    }
+}
+
+static FrameStore *loadDeltas(const RenderContext &rc, const Options &options, ParallelDecoder &decoder)
+{
+    // segments arrive interleaved, so each one is encoded on its own and
+    // starts with a full frame
+    std::map<Decoder*, DeltaEncoder> encoders;
+    std::vector<DeltaFrame> frames(decoder.frameCount);
+    std::vector<bool> decoded(decoder.frameCount, false);
+    size_t loaded = 0;
+    Progress progress("parsing frames", decoder.frameCount);
+
+    while (PixelBuffer *buffer = decoder.wait()) {
+        logDebug() << "parsing frame " << buffer->frame << "\n";
+
+        auto encoder = encoders.find(buffer->decoder);
+        if (encoder == encoders.end()) {
+            encoder = encoders.emplace(buffer->decoder, DeltaEncoder(decoder.width, decoder.height, options.deltaThreshold)).first;
+        }
+
+        if (buffer->frame >= frames.size()) {
+            frames.resize(buffer->frame + 1);
+            decoded.resize(buffer->frame + 1, false);
+        }
+        frames[buffer->frame] = encoder->second.encode(buffer->pixels[0]);
+        decoded[buffer->frame] = true;
+        decoder.release(buffer);
+        progress.update(++loaded);
+    }
+
+    // a gap can only be followed by the full first frame of a segment
+    std::vector<DeltaFrame> complete;
+    for (size_t frameIndex = 0; frameIndex < frames.size(); frameIndex++) {
+        if (decoded[frameIndex]) {
+            complete.push_back(std::move(frames[frameIndex]));
+        }
+    }
+
+    if (complete.empty()) {
+        logWarning() << "no frames were loaded\n";
+        return nullptr;
+    }
+
+    size_t count = complete.size();
+    DeltaStore *store = new DeltaStore(rc, decoder.width, decoder.height, std::move(complete));
+    logInfo() << count << " delta frames use " << store->bytes() / (1024 * 1024) << " MiB instead of "
+        << count * decoder.width * decoder.height * 3 / (1024 * 1024) << " MiB\n";
+
+    return store;
+}
+
+static void printCompressed(const CompressedStore *store, size_t frameCount, size_t frameSize)
+{
+    logInfo() << frameCount << " compressed frames use " << store->bytes() / (1024 * 1024) << " MiB instead of "
+        << frameCount * frameSize / (1024 * 1024) << " MiB\n";
+}
+
+static FrameStore *loadCompressed(const RenderContext &rc, const Options &options, ParallelDecoder &decoder)
+{
+    // segments arrive interleaved, so each one is compressed on its own and
+    // starts with a keyframe
+    size_t frameSize = frameBytes(decoder.format, decoder.width, decoder.height);
+    std::map<Decoder*, FrameCompressor> compressors;
+    std::vector<CompressedFrame> frames(decoder.frameCount);
+    std::vector<bool> decoded(decoder.frameCount, false);
+    size_t loaded = 0, compressedBytes = 0;
+    Progress progress("parsing frames", decoder.frameCount);
+
+    while (PixelBuffer *buffer = decoder.wait()) {
+        logDebug() << "parsing frame " << buffer->frame << "\n";
+
+        auto compressor = compressors.find(buffer->decoder);
+        if (compressor == compressors.end()) {
+            compressor = compressors.emplace(buffer->decoder, FrameCompressor(frameSize)).first;
+        }
+
+        if (buffer->frame >= frames.size()) {
+            frames.resize(buffer->frame + 1);
+            decoded.resize(buffer->frame + 1, false);
+        }
+        frames[buffer->frame] = compressor->second.compress(buffer->pixels[0]);
+        compressedBytes += frames[buffer->frame].data.size();
+        decoded[buffer->frame] = true;
+        decoder.release(buffer);
+        progress.update(++loaded);
+    }
+
+    // a gap can only be followed by the keyframe of a segment
+    std::vector<CompressedFrame> complete;
+    for (size_t frameIndex = 0; frameIndex < frames.size(); frameIndex++) {
+        if (decoded[frameIndex]) {
+            complete.push_back(std::move(frames[frameIndex]));
+        }
+    }
+
+    if (complete.empty()) {
+        logWarning() << "no frames were loaded\n";
+        return nullptr;
+    }
+    if (options.maxMemory > 0 && compressedBytes > options.maxMemory) {
+        logWarning() << "compressed frames take more than the memory budget of "
+            << options.maxMemory / (1024 * 1024) << " MiB\n";
+    }
+
+    size_t count = complete.size();
+    CompressedStore *store = new CompressedStore(rc, decoder.format, decoder.width, decoder.height, std::move(complete));
+    printCompressed(store, count, frameSize);
+
+    return store;
+}
+
+static Video loadCachedVideo(const RenderContext &rc, const Options &options, FrameCache *cache)
+{
+    Video video;
+    video.framerate = cache->framerate;
+    video.frameCount = cache->frameCount;
+
+    if (options.stream) {
+        video.frames = new CacheStore(rc, cache);
+        logInfo() << "streaming video from cache\n";
+        return video;
+    }
+
+    if (options.delta) {
+        DeltaEncoder encoder(cache->width, cache->height, options.deltaThreshold);
+        std::vector<DeltaFrame> frames;
+        for (size_t frameIndex = 0; frameIndex < cache->frameCount; frameIndex++) {
+            frames.push_back(encoder.encode(cache->frame(frameIndex)));
+        }
+
+        DeltaStore *store = new DeltaStore(rc, cache->width, cache->height, std::move(frames));
+        logInfo() << cache->frameCount << " delta frames use " << store->bytes() / (1024 * 1024) << " MiB\n";
+        video.frames = store;
+        delete cache;
+        return video;
+    }
+
+    if (options.compress) {
+        size_t frameSize = frameBytes(cache->format, cache->width, cache->height);
+        FrameCompressor compressor(frameSize);
+        std::vector<CompressedFrame> frames;
+        for (size_t frameIndex = 0; frameIndex < cache->frameCount; frameIndex++) {
+            frames.push_back(compressor.compress(cache->frame(frameIndex)));
+        }
+
+        CompressedStore *store = new CompressedStore(rc, cache->format, cache->width, cache->height, std::move(frames));
+        printCompressed(store, cache->frameCount, frameSize);
+        video.frames = store;
+        delete cache;
+        return video;
+    }
+
+    // the store uploads the rest while the first frames play
+    video.frames = new ProgressiveStore(rc, options, cache);
+    return video;
+}
+
+// GIFs are kept palette-indexed instead of going through OpenCV; returns
+// false if the file could not be decoded
+static Video loadGifVideo(const RenderContext &rc, const Options &options, GifAnimation &&gif)
+{
+    printProperties(rc, gif.width, gif.height, 1);
+    if (options.stream || options.cache || options.prescale || options.delta || options.compress
+        || options.pixelFormat != PixelFormat::RGB24) {
+        logInfo() << "GIF frames are always stored as indices; storage options are ignored\n";
+    }
+    if (options.fps > 0) {
+        logInfo() << "GIF frames keep their own delays; not resampling\n";
+    }
+
+    Video video;
+    size_t frameCount = gif.frames.size();
+    size_t rgbBytes = frameCount * gif.width * gif.height * TEXTURE_PIXEL_BYTES;
+    video.framerate = 100.0 / gif.delayUnit;
+    for (const GifFrame &frame : gif.frames) {
+        video.frameCount += frame.duration;
+    }
+    GifStore *store = new GifStore(rc, std::move(gif));
+    video.frames = store;
+
+    logInfo() << frameCount << " distinct frames take " << store->bytes() / 1024 << " KiB as indices instead of "
+        << rgbBytes / 1024 << " KiB as textures\n";
+    return video;
+}
+
+// with prescaling, frames are converted once for every destination size
+static std::vector<cv::Size> frameSizes(const RenderContext &rc, const Options &options)
+{
+    std::vector<cv::Size> sizes;
+    if (options.prescale) {
+        for (const SDL_Point &size : targetSizes(rc, options)) {
+            sizes.push_back(cv::Size(size.x, size.y));
+        }
+    }
+
+    // streams of frames only come in a single size
+    if ((options.stream || options.delta || options.compress) && sizes.size() > 1) {
+        int width, height;
+        targetSize(rc, options, &width, &height);
+        sizes = { cv::Size(width, height) };
+    }
+
+    return sizes;
+}
+
+static ParallelDecoder *openDecoder(const RenderContext &rc, const Options &options)
+{
+    ParallelDecoder *decoder = new ParallelDecoder(options.videoFile, options.jobs, frameSizes(rc, options),
+                                                   options.pixelFormat, options.fps);
+    if (!decoder->opened()) {
+        delete decoder;
+        return nullptr;
+    }
+    printProperties(rc, decoder->sourceWidth, decoder->sourceHeight, decoder->channels);
+    printRate(decoder->sourceFramerate, decoder->framerate);
+
+    if (options.prescale) {
+        for (const cv::Size &size : decoder->sizes) {
+            logInfo() << "prescaling frames to " << size.width << "x" << size.height << "\n";
+        }
+    }
+
+    return decoder;
+}
+
+// everything before the first texture: the storage plan, the cache file
+// and the decoders of a preloaded video; sets failed if the video can not
+// be opened
+static void prepareFrames(const RenderContext &rc, const Options &requested, PreparedVideo *prepared)
+{
+    // without a renderer, frames stay compressed in RAM at the size they are
+    // drawn at, whatever the budget
+    Options options = rc.sdlr ? planStorage(rc, requested) : requested;
+    if (!rc.sdlr) {
+        if (options.stream || options.delta || options.pixelFormat != PixelFormat::RGB24) {
+            logInfo() << "frames are kept as compressed rgb24 pixels without an SDL renderer\n";
+        }
+        options.compress = true;
+        options.prescale = true;
+        options.stream = false;
+        options.delta = false;
+        options.pixelFormat = PixelFormat::RGB24;
+    }
+    prepared->options = options;
+
+    const std::string &file = options.videoFile;
+    if (options.cache) {
+        int targetWidth, targetHeight;
+        targetSize(rc, options, &targetWidth, &targetHeight);
+
+        CacheKey key;
+        if (!cacheKey(file, targetWidth, targetHeight, options.pixelFormat, options.fps, &key)) {
+            logWarning() << "failed to read video file " << file << "\n";
+            prepared->failed = true;
+            return;
+        }
+
+        FrameCache *cache = FrameCache::open(options.cacheDir, key);
+        if (!cache && FrameCache::build(options.cacheDir, file, key, options.jobs)) {
+            cache = FrameCache::open(options.cacheDir, key);
+        }
+        if (cache) {
+            prepared->cache = cache;
+            return;
+        }
+
+        logWarning() << "continuing without cache\n";
+    }
+
+    logInfo() << "loading video file " << file << "...\n";
+    if (options.stream) {
+        // the decoder buffers are the window ahead of the cursor, plus the
+        // frames on screen if they are decoded into textures
+        PixelFormat format = streamFormat(rc, options.pixelFormat);
+        bool direct = directUpload(rc, format);
+        Decoder *stream = new Decoder(file, options.streamFrames + (direct ? STREAM_SHOWN_FRAMES : 0),
+                                      frameSizes(rc, options), format, options.fps);
+        if (!stream->opened()) {
+            delete stream;
+            prepared->failed = true;
+            return;
+        }
+        printProperties(rc, stream->sourceWidth, stream->sourceHeight, stream->channels);
+        printRate(stream->sourceFramerate, stream->framerate);
+
+        if (stream->frameCount() > STREAM_HEAD_FRAMES + options.streamFrames) {
+            logInfo() << "streaming video with a window of " << options.streamFrames << " frames"
+                << (direct ? ", decoded straight into textures\n" : "\n");
+            prepared->stream = stream;
+            return;
+        }
+
+        logInfo() << "video is short enough to be preloaded; not streaming\n";
+        delete stream;
+        prepared->options.stream = false;
+    }
+
+    prepared->decoder = openDecoder(rc, options);
+    prepared->failed = !prepared->decoder;
+}
+
+PreparedVideo prepareVideo(const RenderContext &rc, const Options &options)
+{
+    PreparedVideo prepared;
+    prepared.options = options;
+    if (rc.sdlr && isGif(options.videoFile)) {
+        // every frame is decoded and composed up front, which takes long for
+        // big GIFs; only the store is left for the render thread
+        logInfo() << "loading GIF file " << options.videoFile << "...\n";
+        GifAnimation *gif = new GifAnimation;
+        if (loadGif(options.videoFile, gif)) {
+            prepared.gif = gif;
+            return prepared;
+        }
+        delete gif;
+        logWarning() << "falling back to OpenCV for " << options.videoFile << "\n";
+    }
+
+    prepareFrames(rc, options, &prepared);
+
+    // frames kept in RAM are parsed here as well, so the render thread only
+    // creates the few textures they are uploaded into
+    const Options &planned = prepared.options;
+    if (!prepared.failed && (!rc.sdlr || (!planned.stream && (planned.delta || planned.compress)))) {
+        prepared.video = loadVideo(rc, &prepared);
+        prepared.failed = !prepared.video.frames;
+    }
+    return prepared;
+}
+
+void discardVideo(PreparedVideo *prepared)
+{
+    delete prepared->cache;
+    delete prepared->decoder;
+    delete prepared->stream;
+    delete prepared->gif;
+    freeVideo(&prepared->video);
+    *prepared = PreparedVideo();
+}
+
+Video loadVideo(const RenderContext &rc, const Options &options)
+{
+    PreparedVideo prepared = prepareVideo(rc, options);
+    Video video = loadVideo(rc, &prepared);
+
+    // playback starts with the first frame while the rest loads
+    while (video.frames && !video.frames->ready()) {
+        if (!video.frames->load(std::chrono::steady_clock::now() + std::chrono::milliseconds(100))
+            && !video.frames->ready()) {
+            logWarning() << "no textures were loaded\n";
+            freeVideo(&video);
+        }
+    }
+
+    return video;
+}
+
+Video loadVideo(const RenderContext &rc, PreparedVideo *prepared)
+{
+    Video video;
+    if (prepared->video.frames) {
+        video = prepared->video;
+        prepared->video = Video();
+        return video;
+    }
+
+    if (prepared->gif) {
+        GifAnimation *gif = prepared->gif;
+        prepared->gif = nullptr;
+        video = loadGifVideo(rc, prepared->options, std::move(*gif));
+        delete gif;
+        return video;
+    }
+    if (prepared->failed) {
+        return video;
+    }
+
+    const Options &options = prepared->options;
+
+    if (options.pixelFormat != PixelFormat::RGB24) {
+        logInfo() << "storing frames as " << formatName(options.pixelFormat) << "\n";
+        if (rc.sdlr && !nativeFormat(rc, options.pixelFormat)) {
+            logInfo() << "the renderer converts " << formatName(options.pixelFormat)
+                << " textures to its own format, so only frames kept outside of textures get smaller\n";
+        }
+    }
+
+    if (prepared->cache) {
+        FrameCache *cache = prepared->cache;
+        prepared->cache = nullptr;
+        return loadCachedVideo(rc, options, cache);
+    }
+
+    if (prepared->stream) {
+        Decoder *stream = prepared->stream;
+        prepared->stream = nullptr;
+        video.framerate = stream->framerate;
+        video.frameCount = stream->frameCount();
+        video.frames = new StreamStore(rc, stream);
+        return video;
+    }
+
+    ParallelDecoder *decoder = prepared->decoder;
+    prepared->decoder = nullptr;
+
+    video.framerate = decoder->framerate;
+    video.frameCount = decoder->frameCount;
+    if (options.delta) {
+        video.frames = loadDeltas(rc, options, *decoder);
+    } else if (options.compress) {
+        video.frames = loadCompressed(rc, options, *decoder);
+    } else {
+        // the store loads the rest while the first frames play
+        video.frames = new ProgressiveStore(rc, options, decoder);
+        return video;
+    }
+    delete decoder;
+    return video;
+}
+
+// blending is only switched on for the copy, as frames are opaque
+static void copyFrame(const RenderContext &rc, FrameStore *frames, int width, int height, const SDL_Rect *area,
+                      Uint8 alpha)
+{
+    SDL_Texture *texture = frames->texture(width, height);
+    const SDL_Rect *source = frames->region();
+    if (alpha == 255) {
+        SDL_RenderCopy(rc.sdlr, texture, source, area);
+        return;
+    }
+
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureAlphaMod(texture, alpha);
+    SDL_RenderCopy(rc.sdlr, texture, source, area);
+    SDL_SetTextureAlphaMod(texture, 255);
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+}
+
+void drawFrame(const RenderContext &rc, const Options &options, FrameStore *frames, Uint8 alpha)
+{
+    if (alpha == 255) {
+        SDL_RenderClear(rc.sdlr);
+    }
+    switch (options.drawType) {
+        case DrawType::MONITOR: {
+            const SDL_Rect &rect = rc.monitors[options.monitorIndex];
+            copyFrame(rc, frames, rect.w, rect.h, &rect, alpha);
+            break;
+        }
+
+        case DrawType::AREA:
+            copyFrame(rc, frames, options.targetArea.w, options.targetArea.h, &options.targetArea, alpha);
+            break;
+
+        case DrawType::STRETCH:
+            copyFrame(rc, frames, rc.sdlwWidth, rc.sdlwHeight, NULL, alpha);
+            break;
+
+        case DrawType::EACH:
+            for (const SDL_Rect &rect : rc.monitors) {
+                copyFrame(rc, frames, rect.w, rect.h, &rect, alpha);
+            }
+
+    }
+}
+
+void freeVideo(Video *video)
+{
+    delete video->frames;
+    video->frames = nullptr;
+}
+
+void targetSize(const RenderContext &rc, const Options &options, int *width, int *height)
+{
+    switch (options.drawType) {
+        case DrawType::MONITOR:
+            *width = rc.monitors[options.monitorIndex].w;
+            *height = rc.monitors[options.monitorIndex].h;
+            break;
+
+        case DrawType::AREA:
+            *width = options.targetArea.w;
+            *height = options.targetArea.h;
+            break;
+
+        case DrawType::STRETCH:
+            *width = rc.sdlwWidth;
+            *height = rc.sdlwHeight;
+            break;
+
+        case DrawType::EACH:
+            // the largest monitor, smaller ones are scaled down when drawing
+            *width = *height = 0;
+            for (const SDL_Rect &rect : rc.monitors) {
+                if (rect.w * rect.h > *width * *height) {
+                    *width = rect.w;
+                    *height = rect.h;
+                }
+            }
+            break;
+    }
+}
+
+std::vector<SDL_Point> targetSizes(const RenderContext &rc, const Options &options)
+{
+    std::vector<SDL_Point> sizes;
+    if (options.drawType != DrawType::EACH) {
+        SDL_Point size;
+        targetSize(rc, options, &size.x, &size.y);
+        sizes.push_back(size);
+        return sizes;
+    }
+
+    // monitors of the same resolution share their frames
+    for (const SDL_Rect &rect : rc.monitors) {
+        bool known = false;
+        for (const SDL_Point &size : sizes) {
+            known = known || (size.x == rect.w && size.y == rect.h);
+        }
+        if (!known) {
+            sizes.push_back({ rect.w, rect.h });
+        }
+    }
+
+    return sizes;
+}
+
+static const uint64_t HASH_PRIME1 = 0x9e3779b185ebca87ull;
+static const uint64_t HASH_PRIME2 = 0xc2b2ae3d27d4eb4full;
+static const uint64_t HASH_PRIME3 = 0x165667b19e3779f9ull;
+static const uint64_t HASH_PRIME4 = 0x85ebca77c2b2ae63ull;
+static const uint64_t HASH_PRIME5 = 0x27d4eb2f165667c5ull;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t hashRound(uint64_t accumulator, uint64_t word)
+{
+    return rotateLeft(accumulator + word * HASH_PRIME2, 31) * HASH_PRIME1;
+}
+
+static inline uint64_t hashMerge(uint64_t hash, uint64_t accumulator)
+{
+    return (hash ^ hashRound(0, accumulator)) * HASH_PRIME1 + HASH_PRIME4;
+}
+
+static inline uint64_t readWord(const uint8_t *data)
+{
+    uint64_t word;
+    memcpy(&word, data, 8);
+    return word;
+}
+
+uint64_t hashBytes(const uint8_t *data, size_t size)
+{
+    size_t pos = 0;
+    uint64_t hash;
+    if (size >= 32) {
+        // four independent lanes keep the multipliers busy
+        uint64_t lanes[4] = { HASH_PRIME1 + HASH_PRIME2, HASH_PRIME2, 0, 0 - HASH_PRIME1 };
+        for (; pos + 32 <= size; pos += 32) {
+            for (int i = 0; i < 4; i++) {
+                lanes[i] = hashRound(lanes[i], readWord(data + pos + i * 8));
+            }
+        }
+        hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+        for (int i = 0; i < 4; i++) {
+            hash = hashMerge(hash, lanes[i]);
+        }
+    } else {
+        hash = HASH_PRIME5;
+    }
+    hash += size;
+
+    for (; pos + 8 <= size; pos += 8) {
+        hash = rotateLeft(hash ^ hashRound(0, readWord(data + pos)), 27) * HASH_PRIME1 + HASH_PRIME4;
+    }
+    if (pos + 4 <= size) {
+        uint32_t word;
+        memcpy(&word, data + pos, 4);
+        hash = rotateLeft(hash ^ word * HASH_PRIME1, 23) * HASH_PRIME2 + HASH_PRIME3;
+        pos += 4;
+    }
+    for (; pos < size; pos++) {
+        hash = rotateLeft(hash ^ data[pos] * HASH_PRIME5, 11) * HASH_PRIME1;
+    }
+
+    // every input bit has to reach every output bit
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+SDL_Texture *createTexture(const RenderContext &rc, uint8_t *pixelData, int width, int height)
+{
+    // convert to SDL_Surface first
+    SDL_Surface *surface = SDL_CreateRGBSurfaceFrom((void*)pixelData, width,
+                                                    height, 24, width * 3, 0x0000ff, 0x00ff00, 0xff0000, 0);
+    if (!surface) {
+        logError() << "Surface could not be created: " << SDL_GetError() << "\n";
+        return nullptr;
+    }
+
+    // for some reason textures are stored in RAM instead of VRAM so large videos
+    // may cause problems, TODO fix or add warning
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(rc.sdlr, surface);
+    SDL_FreeSurface(surface);
+
+    return texture;
+}
+
+SDL_Texture *createTexture(const RenderContext &rc, PixelFormat format, uint8_t *pixelData, int width, int height)
+{
+    // the renderer picks its own format for 24 bit RGB
+    if (format == PixelFormat::RGB24) {
+        return createTexture(rc, pixelData, width, height);
+    }
+
+    SDL_Texture *texture = SDL_CreateTexture(rc.sdlr, sdlFormat(format), SDL_TEXTUREACCESS_STATIC, width, height);
+    if (!texture) {
+        logError() << "Texture could not be created: " << SDL_GetError() << "\n";
+        return nullptr;
+    }
+
+    if (SDL_UpdateTexture(texture, NULL, pixelData, framePitch(format, width)) != 0) {
+        logError() << "Texture could not be updated: " << SDL_GetError() << "\n";
+        SDL_DestroyTexture(texture);
+        return nullptr;
+    }
+
+    return texture;
+}
+
+size_t textureMemory(SDL_Texture *texture)
+{
+    Uint32 format;
+    int width, height;
+    if (!texture || SDL_QueryTexture(texture, &format, NULL, &width, &height) != 0) {
+        return 0;
+    }
+
+    // planar YUV has chroma at a quarter of the resolution, and 24 bit
+    // pixels are padded to 32 bits
+    if (SDL_ISPIXELFORMAT_FOURCC(format)) {
+        return (size_t)width * height * 3 / 2;
+    }
+    size_t pixelBytes = SDL_BYTESPERPIXEL(format);
+    return (size_t)width * height * (pixelBytes == 3 ? TEXTURE_PIXEL_BYTES : pixelBytes);
+}
+
+Uint32 sdlFormat(PixelFormat format)
+{
+    switch (format) {
+        case PixelFormat::IYUV:
+            return SDL_PIXELFORMAT_IYUV;
+        case PixelFormat::NV12:
+            return SDL_PIXELFORMAT_NV12;
+        case PixelFormat::RGB565:
+            return SDL_PIXELFORMAT_RGB565;
+        case PixelFormat::XRGB32:
+            // named by the bits of a 32 bit word
+            return SDL_BYTEORDER == SDL_LIL_ENDIAN ? SDL_PIXELFORMAT_RGB888 : SDL_PIXELFORMAT_BGRX8888;
+        default:
+            return SDL_PIXELFORMAT_RGB24;
+    }
+}
+
+bool nativeFormat(const RenderContext &rc, PixelFormat format)
+{
+    return std::find(rc.textureFormats.begin(), rc.textureFormats.end(), sdlFormat(format)) != rc.textureFormats.end();
+}
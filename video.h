@@ -0,0 +1,157 @@
+#ifndef VIDEO_H_INCLUDED
+#define VIDEO_H_INCLUDED
+
+#include "xanim.h"
+
+#include <chrono>
+
+#include <stdint.h>
+
+// supplies the render loop with the frames of the video, in loop order
+class FrameStore {
+public:
+    virtual ~FrameStore() {}
+
+    // advances to the next frame; returns false if it is not ready yet, in
+    // which case the current frame is held
+    virtual bool next() = 0;
+    // texture showing the current frame, preferably one which was scaled for
+    // a destination of the given size
+    virtual SDL_Texture *texture(int width, int height) = 0;
+    // number of frame periods the current frame stays on screen
+    virtual int duration() { return 1; }
+    // memory held by the frames in textures and buffers
+    virtual size_t residentBytes() const = 0;
+    // the current frame as tightly packed 24 bit RGB for stores which keep
+    // frames in RAM, nullptr otherwise; rows outside [first, last] did not
+    // change since the last call
+    virtual const uint8_t *pixels(int *width, int *height, int *first, int *last) { return nullptr; }
+    // loads more of the video until the given time for stores which start
+    // playing before everything is loaded; returns false once nothing is
+    // left to load
+    virtual bool load(std::chrono::steady_clock::time_point until) { return false; }
+    // whether the first frame was loaded, so next() can be called
+    virtual bool ready() const { return true; }
+    // part of the texture last returned by texture() which shows the frame,
+    // nullptr for all of it
+    virtual const SDL_Rect *region() const { return nullptr; }
+};
+
+// every distinct frame is kept as its own texture or a cell of an atlas
+// texture, optionally in several sizes; the timeline says which one is shown
+// for how long
+class TextureStore : public FrameStore {
+public:
+    ~TextureStore();
+
+    bool next() override;
+    SDL_Texture *texture(int width, int height) override;
+    int duration() override;
+    size_t residentBytes() const override;
+    const SDL_Rect *region() const override { return shownRegion; }
+
+    struct Slot {
+        SDL_Texture *texture;
+        size_t frame; // distinct frame the texture shows
+        uint64_t used; // when it was last shown
+    };
+    struct Variant {
+        int width, height;
+        std::vector<SDL_Texture*> sdlTextures; // SDL Textures of the distinct frames, nullptr if spilled
+        // pixels of frames which did not fit into the texture budget
+        std::vector<std::vector<uint8_t>> spilled;
+        std::vector<Slot> slots; // spilled frames uploaded most recently
+        // small frames share atlas textures of columns x rows frames, so the
+        // sdlTextures of several frames are the same atlas
+        int atlasColumns = 0, atlasRows = 0;
+        std::vector<SDL_Texture*> atlases;
+        std::vector<SDL_Rect> regions; // where each frame is in its texture
+    };
+    std::vector<Variant> variants; // largest first
+
+    struct Entry {
+        size_t texture; // index into the textures of every variant
+        int duration; // in frame periods
+    };
+    std::vector<Entry> timeline;
+    std::vector<uint64_t> shown; // when each distinct frame was last shown
+
+    PixelFormat format = PixelFormat::RGB24; // of spilled frames
+    SDL_Renderer *sdlr = nullptr; // creates the slots of spilled frames
+    // once textures take more than this many bytes while playing, 0 meaning
+    // no limit, the least recently shown frames are spilled
+    size_t maxMemory = 0;
+
+private:
+    SDL_Texture *upload(Variant&, size_t index);
+    // spills the textures of the least recently shown frame; returns false
+    // if there is none or they can not be read back
+    bool evict();
+
+    size_t cursor = SIZE_MAX;
+    uint64_t tick = 0;
+    bool overBudget = false;
+    const SDL_Rect *shownRegion = nullptr; // in the texture texture() returned
+};
+
+struct Video {
+    FrameStore *frames = nullptr; // frame storage used for playback
+    double framerate; // frames per second
+    size_t frameCount = 0; // frame periods of one loop
+};
+
+class FrameCache;
+class Decoder;
+class ParallelDecoder;
+struct GifAnimation;
+
+// what is opened before the first texture of a video is created; preparing
+// never touches the renderer, so it can run on another thread while a
+// different video plays
+struct PreparedVideo {
+    Options options; // with the storage plan applied
+    bool failed = false; // the video can not be played
+    GifAnimation *gif = nullptr; // frames of a GIF, which only need their store
+    FrameCache *cache = nullptr;
+    ParallelDecoder *decoder = nullptr; // of a preloaded video
+    Decoder *stream = nullptr; // of a streamed video, not started yet
+    // the whole video if it is kept in RAM; its few textures are only
+    // created by load()
+    Video video;
+};
+
+// loads a video and returns once its first frame can be shown; a video
+// which can not be played has no frames, which is logged as a warning
+Video loadVideo(const RenderContext&, const Options&);
+PreparedVideo prepareVideo(const RenderContext&, const Options&);
+// takes over what was prepared; the store may not be ready() yet, in
+// which case load() has to be called until it is, and has no frames if
+// the video can not be played
+Video loadVideo(const RenderContext&, PreparedVideo*);
+void discardVideo(PreparedVideo*);
+void freeVideo(Video*);
+// copies the current frame onto every area it is drawn on, clearing the
+// renderer first unless the frame is blended over what is there with an
+// alpha below 255; the caller presents
+void drawFrame(const RenderContext&, const Options&, FrameStore*, Uint8 alpha = 255);
+
+// size of the largest area a frame is drawn on
+void targetSize(const RenderContext&, const Options&, int *width, int *height);
+// distinct sizes of all areas a frame is drawn on
+std::vector<SDL_Point> targetSizes(const RenderContext&, const Options&);
+
+// xxHash64 with seed 0, so every bit of the input changes the whole hash
+uint64_t hashBytes(const uint8_t *data, size_t size);
+
+// create a static texture from tightly packed 24 bit RGB
+SDL_Texture *createTexture(const RenderContext&, uint8_t *pixelData, int width, int height);
+// create a static texture from a tightly packed frame of the given format
+SDL_Texture *createTexture(const RenderContext&, PixelFormat, uint8_t *pixelData, int width, int height);
+// memory a texture takes, as far as SDL tells
+size_t textureMemory(SDL_Texture*);
+// SDL pixel format of textures holding frames of the given format
+Uint32 sdlFormat(PixelFormat);
+// whether the renderer stores textures of the format without converting them
+bool nativeFormat(const RenderContext&, PixelFormat);
+
+#endif
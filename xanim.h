@@ -0,0 +1,85 @@
+#ifndef XANIM_H_INCLUDED
+#define XANIM_H_INCLUDED
+
+// root window
+#include <X11/Xlib.h>
+
+// rendering
+#include <SDL2/SDL.h>
+
+#include "format.h"
+
+#include <vector>
+#include <string>
+
+class RenderBackend;
+
+struct RenderContext {
+    Display*        dpy; // X11 display
+    Window          rootw; // X11 root window
+    SDL_Window*     sdlw; // SDL window
+    SDL_Renderer*   sdlr; // SDL renderer, nullptr if frames are kept as pixels instead of textures
+    RenderBackend*  backend = nullptr; // shows the frames
+    int sdlwWidth, sdlwHeight; // SDL window dimensions
+    int refreshRate; // display refresh rate in Hz if presents are vsynced, otherwise 0
+    // texture formats the renderer stores as they are; queried once, so
+    // threads other than the render thread never ask the renderer
+    std::vector<Uint32> textureFormats;
+
+    std::vector<SDL_Rect> monitors;
+};
+
+enum class DrawType {
+    MONITOR, // video is played given monitor
+    AREA, // video is played on given area
+    STRETCH, // video is played over all monitors
+    EACH // video is played on each monitor
+};
+
+enum class Backend {
+    AUTO, // XSHM if SDL only offers its software renderer, SDL otherwise
+    SDL, // SDL_Renderer on a window wrapping the root window
+    XSHM // frames converted straight into shared memory images
+};
+
+struct PlaylistEntry {
+    std::string file;
+    int seconds = 0; // how long the video plays, 0 to count loops instead
+    int loops = 1; // loops of the video played if seconds is 0
+};
+
+struct Options {
+    DrawType drawType = DrawType::MONITOR;
+    int monitorIndex = 0;
+    SDL_Rect targetArea;
+    std::string videoFile;
+    std::vector<PlaylistEntry> playlist; // played in turn, videoFile is the first one
+    int crossfade = 0; // ms the videos of a playlist blend into each other
+    std::string controlPath; // unix socket taking commands, none if empty
+    bool governor = false; // lower the rate on battery or under load
+    int cpuBudget = 0; // percent of a core xanim may take, 0 for no limit
+    bool idleThreads = false; // loading threads run with SCHED_IDLE
+    double fps = 0; // frames are resampled to this rate while loading, 0 keeps the source rate
+
+    bool stream = false; // decode while playing instead of preloading
+    size_t streamFrames = 16; // number of frames kept ahead of the play cursor
+    int jobs = 0; // decoder threads while preloading, 0 for one per core
+    bool prescale = false; // scale frames to their destination while loading
+    PixelFormat pixelFormat = PixelFormat::RGB24; // how frames are stored
+    Backend backend = Backend::AUTO;
+    bool delta = false; // store only the changed parts of each frame
+    int deltaThreshold = 4; // channel difference still counted as unchanged
+    bool compress = false; // keep frames compressed in RAM and decompress them while playing
+    size_t maxMemory = 0; // bytes frames may take, 0 for no limit
+    int idleRelease = -1; // seconds the screen is hidden before frames are freed, -1 keeps them
+    int mergeThreshold = 0; // average difference of consecutive frames which are merged, 0 for exact repeats
+
+    std::string statsFile; // rewritten with playback statistics, empty for none
+    int statsInterval = 10; // seconds between rewrites of the stats file
+
+    bool cache = false; // use and create preprocessed frame cache files
+    bool buildCache = false; // only write the cache file and exit
+    std::string cacheDir;
+};
+
+#endif